@@ -0,0 +1,846 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <inttypes.h>
+#include <math.h>
+#include <time.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "bitree.h"
+#include "bitree_parallel.h"
+#include "bitree_sync.h"
+#include "btree.h"
+#include "radix.h"
+#include "map_gen.h"
+
+// Benchmark driver for the map engines. Every result is one record on
+// stdout, JSON lines by default or CSV with --format csv.
+
+#define KEY_MAX 96
+#define BATCH 1024
+// Keys per BiTree_insertBatch / BiTree_deleteBatch call
+#define INGEST_BATCH 10000
+// O(n) search modes (bfs, dfs) get at most this many node visits per run
+#define SCAN_BUDGET 20000000ull
+#define ZIPF_S 0.99
+
+typedef enum { DIST_RANDOM, DIST_SORTED, DIST_REVERSE, DIST_ZIPF, DIST_PREFIX, DIST_COUNT } Dist;
+static const char *dist_names[DIST_COUNT] = { "random", "sorted", "reverse", "zipf", "prefix" };
+
+typedef struct {
+    Dist dist;
+    uint64_t n;
+    uint64_t lookups;
+    double zipf_base;           // n^(1-s) - 1, for inverse-CDF sampling
+    uint64_t rng;
+} Workload;
+
+typedef struct {
+    const char *dists;
+    const char *sizes;
+    const char *ops;
+    uint64_t lookups;
+    int threads;
+    double zipf;                // skew of the zipf workload
+    bool csv;
+    bool header_done;
+} Options;
+
+static Options options = {
+    "random,sorted,reverse,zipf,prefix", "1000,10000,100000,1000000", "all", 1000000, 4, ZIPF_S, false, false
+};
+
+// --- timing and latency histogram -----------------------------------------
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+// Log-linear histogram: 16 sub-buckets per power of two, ~6% resolution
+#define HIST_SUB 16
+#define HIST_BUCKETS (64 * HIST_SUB)
+
+typedef struct {
+    uint64_t counts[HIST_BUCKETS];
+    uint64_t total_ns;
+    uint64_t ops;
+} Histogram;
+
+static int hist_bucket(uint64_t ns) {
+    if (ns < HIST_SUB) {
+        return (int)ns;
+    }
+    int log = 63 - __builtin_clzll(ns);
+    int sub = (int)((ns >> (log - 4)) & (HIST_SUB - 1));
+    return (log - 3) * HIST_SUB + sub;
+}
+
+static uint64_t hist_value(int bucket) {
+    if (bucket < HIST_SUB) {
+        return bucket;
+    }
+    int log = bucket / HIST_SUB + 3;
+    uint64_t sub = bucket % HIST_SUB;
+    return ((uint64_t)HIST_SUB + sub) << (log - 4);
+}
+
+// Record a sample of ns covering ops operations (batched calls)
+static void hist_add(Histogram *hist, uint64_t ns, uint64_t ops) {
+    hist->counts[hist_bucket(ops > 1 ? ns / ops : ns)] += ops;
+    hist->total_ns += ns;
+    hist->ops += ops;
+}
+
+static uint64_t hist_percentile(const Histogram *hist, double q) {
+    uint64_t rank = (uint64_t)ceil(q * hist->ops);
+    uint64_t seen = 0;
+    for (int i = 0; i < HIST_BUCKETS; i++) {
+        seen += hist->counts[i];
+        if (seen >= rank && seen > 0) {
+            return hist_value(i);
+        }
+    }
+    return 0;
+}
+
+static void report(const char *engine, const char *op, const Workload *w, int threads, const Histogram *hist) {
+    double seconds = hist->total_ns / 1e9;
+    double rate = seconds > 0 ? hist->ops / seconds : 0;
+    uint64_t p50 = hist_percentile(hist, 0.50);
+    uint64_t p99 = hist_percentile(hist, 0.99);
+    uint64_t p999 = hist_percentile(hist, 0.999);
+    if (options.csv) {
+        if (!options.header_done) {
+            printf("engine,op,dist,n,threads,ops,seconds,ops_per_sec,p50_ns,p99_ns,p999_ns\n");
+            options.header_done = true;
+        }
+        printf("%s,%s,%s,%" PRIu64 ",%d,%" PRIu64 ",%.6f,%.0f,%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n",
+               engine, op, dist_names[w->dist], w->n, threads, hist->ops, seconds, rate, p50, p99, p999);
+    } else {
+        printf("{\"engine\":\"%s\",\"op\":\"%s\",\"dist\":\"%s\",\"n\":%" PRIu64 ",\"threads\":%d,"
+               "\"ops\":%" PRIu64 ",\"seconds\":%.6f,\"ops_per_sec\":%.0f,"
+               "\"p50_ns\":%" PRIu64 ",\"p99_ns\":%" PRIu64 ",\"p999_ns\":%" PRIu64 "}\n",
+               engine, op, dist_names[w->dist], w->n, threads, hist->ops, seconds, rate, p50, p99, p999);
+    }
+    fflush(stdout);
+}
+
+// --- key generation --------------------------------------------------------
+
+// splitmix64 finalizer: a bijection, so distinct inputs give distinct keys
+static uint64_t mix64(uint64_t x) {
+    x += 0x9E3779B97F4A7C15ull;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ull;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+static uint64_t next_random(Workload *w) {
+    w->rng = w->rng * 6364136223846793005ull + 1442695040888963407ull;
+    return mix64(w->rng);
+}
+
+// Key of the i-th inserted element
+static void make_key(const Workload *w, uint64_t i, char *key) {
+    switch (w->dist) {
+    case DIST_SORTED:
+        sprintf(key, "%016" PRIx64, i);
+        break;
+    case DIST_REVERSE:
+        sprintf(key, "%016" PRIx64, w->n - 1 - i);
+        break;
+    case DIST_PREFIX:
+        sprintf(key, "/srv/data/tenants/acme/projects/alpha/buckets/primary/objects/%016" PRIx64, mix64(i));
+        break;
+    default:
+        sprintf(key, "%016" PRIx64, mix64(i));
+        break;
+    }
+}
+
+// Index of the next key to look up: Zipf-skewed for the zipf workload,
+// uniform otherwise. Zipf ranks use the continuous inverse CDF.
+static uint64_t lookup_index(Workload *w) {
+    if (w->dist != DIST_ZIPF) {
+        return next_random(w) % w->n;
+    }
+    double u = (next_random(w) >> 11) * (1.0 / 9007199254740992.0);
+    double rank = pow(w->zipf_base * u + 1.0, 1.0 / (1.0 - options.zipf)) - 1.0;
+    uint64_t index = (uint64_t)rank;
+    return index < w->n ? index : w->n - 1;
+}
+
+// Bijective shuffle of [0, n) without a permutation table
+typedef struct {
+    uint64_t n;
+    uint64_t step;
+} Shuffle;
+
+static uint64_t gcd(uint64_t a, uint64_t b) {
+    while (b != 0) {
+        uint64_t t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static Shuffle shuffle_new(uint64_t n) {
+    Shuffle s = { n, n > 1 ? (0x9E3779B97F4A7C15ull % n) | 1 : 1 };
+    while (n > 1 && gcd(s.step, n) != 1) {
+        s.step += 2;
+    }
+    return s;
+}
+
+static uint64_t shuffle_at(const Shuffle *s, uint64_t i) {
+    return (uint64_t)(((unsigned __int128)i * s->step + 12345) % s->n);
+}
+
+static bool want(const char *list, const char *name) {
+    if (strcmp(list, "all") == 0) {
+        return true;
+    }
+    size_t length = strlen(name);
+    for (const char *p = list; (p = strstr(p, name)) != NULL; p += length) {
+        bool starts = p == list || p[-1] == ',';
+        bool ends = p[length] == '\0' || p[length] == ',';
+        if (starts && ends) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// --- BiTree ----------------------------------------------------------------
+
+static BiTree* bench_insert(Workload *w) {
+    BiTree *tree = BiTree_new(NULL);
+    Histogram hist = { 0 };
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, i, key);
+        uint64_t start = now_ns();
+        BiTree_insert(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    if (want(options.ops, "insert")) {
+        report("bitree", "insert", w, 1, &hist);
+    }
+    return tree;
+}
+
+static void bench_search(Workload *w, BiTree *tree, const char *mode) {
+    char name[32];
+    snprintf(name, sizeof(name), "search_%s", mode);
+    if (!want(options.ops, name)) {
+        return;
+    }
+    uint64_t lookups = w->lookups;
+    if (strcmp(mode, "bfs") == 0 || strcmp(mode, "dfs") == 0) {
+        uint64_t cap = SCAN_BUDGET / (w->n > 0 ? w->n : 1);
+        lookups = lookups < cap ? lookups : (cap > 0 ? cap : 1);
+    }
+
+    Histogram hist = { 0 };
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < lookups; i++) {
+        make_key(w, lookup_index(w), key);
+        uint64_t start = now_ns();
+        BiTree *found = BiTree_search(tree->root, key, (char *)mode);
+        hist_add(&hist, now_ns() - start, 1);
+        free(found);
+    }
+    report("bitree", name, w, 1, &hist);
+}
+
+// rank and select: the order statistics kept by the subtree sizes
+static void bench_order(Workload *w, BiTree *tree) {
+    char key[KEY_MAX];
+    if (want(options.ops, "rank")) {
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            make_key(w, lookup_index(w), key);
+            uint64_t start = now_ns();
+            BiTree_rank(tree->root, key);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "rank", w, 1, &hist);
+    }
+    if (want(options.ops, "select")) {
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            uint64_t k = lookup_index(w);
+            uint64_t start = now_ns();
+            BiTree_select(tree->root, k);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "select", w, 1, &hist);
+    }
+}
+
+static void bench_search_batch(Workload *w, BiTree *tree) {
+    if (!want(options.ops, "search_batch")) {
+        return;
+    }
+    char (*storage)[KEY_MAX] = malloc(BATCH * KEY_MAX);
+    const char **keys = malloc(BATCH * sizeof(char *));
+    BiTreeNode **out = malloc(BATCH * sizeof(BiTreeNode *));
+    Histogram hist = { 0 };
+    for (uint64_t done = 0; done < w->lookups; done += BATCH) {
+        size_t count = w->lookups - done < BATCH ? w->lookups - done : BATCH;
+        for (size_t i = 0; i < count; i++) {
+            make_key(w, lookup_index(w), storage[i]);
+            keys[i] = storage[i];
+        }
+        uint64_t start = now_ns();
+        BiTree_searchBatch(tree->root, keys, count, out);
+        hist_add(&hist, now_ns() - start, count);
+    }
+    report("bitree", "search_batch", w, 1, &hist);
+    free(storage);
+    free(keys);
+    free(out);
+}
+
+// Lookups in the Eytzinger array made by BiTree_freeze
+static void bench_frozen(Workload *w, BiTree *tree) {
+    if (!want(options.ops, "freeze") && !want(options.ops, "frozen_search")) {
+        return;
+    }
+    Histogram hist = { 0 };
+    uint64_t start = now_ns();
+    BiTreeFrozen *frozen = BiTree_freeze(tree);
+    hist_add(&hist, now_ns() - start, w->n);
+    if (frozen == NULL) {
+        return;
+    }
+    if (want(options.ops, "freeze")) {
+        report("bitree", "freeze", w, 1, &hist);
+    }
+    if (want(options.ops, "frozen_search")) {
+        memset(&hist, 0, sizeof(hist));
+        char key[KEY_MAX];
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            make_key(w, lookup_index(w), key);
+            start = now_ns();
+            BiTreeFrozen_find(frozen, key);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "frozen_search", w, 1, &hist);
+    }
+    BiTreeFrozen_destroy(frozen);
+}
+
+// Exact-match lookups through BiTree_lookup, by descent and then through
+// the hash index of BiTree_enableIndex
+static void bench_index(Workload *w, BiTree *tree) {
+    static const char *ops[] = { "lookup", "search_index" };
+    char key[KEY_MAX];
+    for (size_t op = 0; op < sizeof(ops) / sizeof(ops[0]); op++) {
+        if (!want(options.ops, ops[op])) {
+            continue;
+        }
+        if (op == 1) {
+            Histogram hist = { 0 };
+            uint64_t start = now_ns();
+            bool ok = BiTree_enableIndex(tree);
+            hist_add(&hist, now_ns() - start, w->n);
+            if (!ok) {
+                return;
+            }
+            report("bitree", "index_build", w, 1, &hist);
+        }
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            make_key(w, lookup_index(w), key);
+            uint64_t start = now_ns();
+            BiTree_lookup(tree, key);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", ops[op], w, 1, &hist);
+    }
+    BiTree_disableIndex(tree);
+}
+
+// The same lookups with the tree in splay mode, where hot keys move up to
+// the root; compare with lookup, mostly on the zipf workload. The tree is
+// rebuilt into AVL shape afterwards for the benchmarks that follow.
+static void bench_splay(Workload *w, BiTree *tree) {
+    char key[KEY_MAX];
+    if (want(options.ops, "splay_lookup")) {
+        BiTree_setSplay(tree, true);
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            make_key(w, lookup_index(w), key);
+            uint64_t start = now_ns();
+            BiTree_lookup(tree, key);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "splay_lookup", w, 1, &hist);
+
+        memset(&hist, 0, sizeof(hist));
+        uint64_t start = now_ns();
+        BiTree_setSplay(tree, false);
+        hist_add(&hist, now_ns() - start, w->n);
+        report("bitree", "splay_rebuild", w, 1, &hist);
+    }
+    if (want(options.ops, "splay_insert")) {
+        BiTree *splayed = BiTree_new(NULL);
+        BiTree_setSplay(splayed, true);
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->n; i++) {
+            make_key(w, i, key);
+            uint64_t start = now_ns();
+            BiTree_insert(splayed, key);
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "splay_insert", w, 1, &hist);
+        BiTree_destroy(splayed);
+    }
+}
+
+// The map calls: counters bumped in place through BiTree_getOrInsert on
+// the lookup keys, all hits, and a fresh tree filled by BiTree_put
+static void bench_map(Workload *w, BiTree *tree) {
+    char key[KEY_MAX];
+    if (want(options.ops, "map_incr")) {
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->lookups; i++) {
+            make_key(w, lookup_index(w), key);
+            uint64_t start = now_ns();
+            BiTree_getOrInsert(tree, key, NULL)->u64++;
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "map_incr", w, 1, &hist);
+    }
+    if (want(options.ops, "map_put")) {
+        BiTree *map = BiTree_new(NULL);
+        Histogram hist = { 0 };
+        for (uint64_t i = 0; i < w->n; i++) {
+            make_key(w, i, key);
+            uint64_t start = now_ns();
+            BiTree_put(map, key, (BiTreeValue){ .u64 = i });
+            hist_add(&hist, now_ns() - start, 1);
+        }
+        report("bitree", "map_put", w, 1, &hist);
+        BiTree_destroy(map);
+    }
+}
+
+// Ingest in batches: a tree built with BiTree_insertBatch and torn down
+// with BiTree_deleteBatch, INGEST_BATCH unsorted keys per call
+static void bench_batch_update(Workload *w) {
+    if (!want(options.ops, "insert_batch") && !want(options.ops, "delete_batch")) {
+        return;
+    }
+    BiTree *tree = BiTree_new(NULL);
+    char (*storage)[KEY_MAX] = malloc(INGEST_BATCH * KEY_MAX);
+    const char **keys = malloc(INGEST_BATCH * sizeof(char *));
+    Histogram hist = { 0 };
+    for (uint64_t done = 0; done < w->n; done += INGEST_BATCH) {
+        size_t count = w->n - done < INGEST_BATCH ? w->n - done : INGEST_BATCH;
+        for (size_t i = 0; i < count; i++) {
+            make_key(w, done + i, storage[i]);
+            keys[i] = storage[i];
+        }
+        uint64_t start = now_ns();
+        BiTree_insertBatch(tree, keys, count, false);
+        hist_add(&hist, now_ns() - start, count);
+    }
+    if (want(options.ops, "insert_batch")) {
+        report("bitree", "insert_batch", w, 1, &hist);
+    }
+
+    memset(&hist, 0, sizeof(hist));
+    Shuffle order = shuffle_new(w->n);
+    for (uint64_t done = 0; done < w->n; done += INGEST_BATCH) {
+        size_t count = w->n - done < INGEST_BATCH ? w->n - done : INGEST_BATCH;
+        for (size_t i = 0; i < count; i++) {
+            make_key(w, shuffle_at(&order, done + i), storage[i]);
+            keys[i] = storage[i];
+        }
+        uint64_t start = now_ns();
+        BiTree_deleteBatch(tree, keys, count, false);
+        hist_add(&hist, now_ns() - start, count);
+    }
+    if (want(options.ops, "delete_batch")) {
+        report("bitree", "delete_batch", w, 1, &hist);
+    }
+    free(storage);
+    free(keys);
+    BiTree_destroy(tree);
+}
+
+static void bench_persist(Workload *w, BiTree *tree) {
+    char path[] = "/tmp/libmap-bench-XXXXXX";
+    int fd = mkstemp(path);
+    if (fd < 0) {
+        return;
+    }
+    close(fd);
+
+    if (want(options.ops, "serialize") || want(options.ops, "deserialize")) {
+        Histogram hist = { 0 };
+        FILE *fp = fopen(path, "w");
+        uint64_t start = now_ns();
+        BiTree_serialize(fp, tree->root, "dfs");
+        fclose(fp);
+        hist_add(&hist, now_ns() - start, w->n);
+        if (want(options.ops, "serialize")) {
+            report("bitree", "serialize", w, 1, &hist);
+        }
+
+        memset(&hist, 0, sizeof(hist));
+        fp = fopen(path, "r");
+        start = now_ns();
+        BiTreeNode *root = BiTree_deserialize(fp);
+        hist_add(&hist, now_ns() - start, w->n);
+        fclose(fp);
+        BiTree_free(root);
+        if (want(options.ops, "deserialize")) {
+            report("bitree", "deserialize", w, 1, &hist);
+        }
+    }
+
+    if (want(options.ops, "snapshot_save") || want(options.ops, "snapshot_load")) {
+        Histogram hist = { 0 };
+        uint64_t start = now_ns();
+        BiTree_saveSnapshot(tree, path);
+        hist_add(&hist, now_ns() - start, w->n);
+        if (want(options.ops, "snapshot_save")) {
+            report("bitree", "snapshot_save", w, 1, &hist);
+        }
+
+        memset(&hist, 0, sizeof(hist));
+        start = now_ns();
+        BiTree *loaded = BiTree_loadSnapshot(path);
+        hist_add(&hist, now_ns() - start, w->n);
+        BiTree_destroy(loaded);
+        if (want(options.ops, "snapshot_load")) {
+            report("bitree", "snapshot_load", w, 1, &hist);
+        }
+    }
+
+    if (want(options.ops, "snapshot_load_parallel")) {
+        BiTree_saveSnapshot(tree, path);
+        TaskPool *pool = TaskPool_new(options.threads);
+        Histogram hist = { 0 };
+        uint64_t start = now_ns();
+        BiTree *loaded = BiTree_loadSnapshotParallel(pool, path);
+        hist_add(&hist, now_ns() - start, w->n);
+        BiTree_destroy(loaded);
+        TaskPool_destroy(pool);
+        report("bitree", "snapshot_load_parallel", w, options.threads, &hist);
+    }
+    remove(path);
+}
+
+static void bench_delete(Workload *w, BiTree *tree) {
+    Histogram hist = { 0 };
+    Shuffle order = shuffle_new(w->n);
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, shuffle_at(&order, i), key);
+        uint64_t start = now_ns();
+        BiTree_delete(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    if (want(options.ops, "delete")) {
+        report("bitree", "delete", w, 1, &hist);
+    }
+}
+
+static void run_bitree(Workload *w) {
+    BiTree *tree = bench_insert(w);
+    static const char *modes[] = { "key", "bfs", "dfs" };
+    for (size_t i = 0; i < sizeof(modes) / sizeof(modes[0]); i++) {
+        bench_search(w, tree, modes[i]);
+    }
+    bench_search_batch(w, tree);
+    bench_order(w, tree);
+    bench_frozen(w, tree);
+    bench_index(w, tree);
+    bench_splay(w, tree);
+    bench_map(w, tree);
+    bench_persist(w, tree);
+    bench_delete(w, tree);
+    BiTree_destroy(tree);
+    bench_batch_update(w);
+}
+
+// --- BTree -----------------------------------------------------------------
+
+static void run_btree(Workload *w) {
+    if (!want(options.ops, "btree")) {
+        return;
+    }
+    BTree *tree = BTree_new();
+    Histogram hist = { 0 };
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, i, key);
+        uint64_t start = now_ns();
+        BTree_insert(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("btree", "insert", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    for (uint64_t i = 0; i < w->lookups; i++) {
+        make_key(w, lookup_index(w), key);
+        uint64_t start = now_ns();
+        BTree_search(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("btree", "search", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    Shuffle order = shuffle_new(w->n);
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, shuffle_at(&order, i), key);
+        uint64_t start = now_ns();
+        BTree_delete(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("btree", "delete", w, 1, &hist);
+    BTree_destroy(tree);
+}
+
+// --- radix tree ------------------------------------------------------------
+
+static void run_radix(Workload *w) {
+    if (!want(options.ops, "radix")) {
+        return;
+    }
+    Radix *tree = Radix_new();
+    Histogram hist = { 0 };
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, i, key);
+        uint64_t start = now_ns();
+        Radix_insert(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("radix", "insert", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    for (uint64_t i = 0; i < w->lookups; i++) {
+        make_key(w, lookup_index(w), key);
+        uint64_t start = now_ns();
+        Radix_search(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("radix", "search", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    Shuffle order = shuffle_new(w->n);
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, shuffle_at(&order, i), key);
+        uint64_t start = now_ns();
+        Radix_delete(tree, key);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("radix", "delete", w, 1, &hist);
+    Radix_destroy(tree);
+}
+
+// --- generated integer map ----------------------------------------------
+
+MAP_GENERATE(IdMap, uint64_t, uint64_t, MAP_CMP_NUMBER)
+
+// 64-bit id of the i-th inserted element; shared-prefix keys have no
+// integer form and use the random ids
+static uint64_t make_id(const Workload *w, uint64_t i) {
+    switch (w->dist) {
+    case DIST_SORTED:
+        return i;
+    case DIST_REVERSE:
+        return w->n - 1 - i;
+    default:
+        return mix64(i);
+    }
+}
+
+static void run_idmap(Workload *w) {
+    if (!want(options.ops, "idmap")) {
+        return;
+    }
+    IdMap *map = IdMap_new();
+    Histogram hist = { 0 };
+    for (uint64_t i = 0; i < w->n; i++) {
+        uint64_t id = make_id(w, i);
+        uint64_t start = now_ns();
+        IdMap_put(map, id, i);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("idmap", "insert", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    for (uint64_t i = 0; i < w->lookups; i++) {
+        uint64_t id = make_id(w, lookup_index(w));
+        uint64_t start = now_ns();
+        IdMap_get(map, id);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("idmap", "search", w, 1, &hist);
+
+    memset(&hist, 0, sizeof(hist));
+    Shuffle order = shuffle_new(w->n);
+    for (uint64_t i = 0; i < w->n; i++) {
+        uint64_t id = make_id(w, shuffle_at(&order, i));
+        uint64_t start = now_ns();
+        IdMap_remove(map, id, NULL);
+        hist_add(&hist, now_ns() - start, 1);
+    }
+    report("idmap", "delete", w, 1, &hist);
+    IdMap_destroy(map);
+}
+
+// --- BiTreeSync read scaling ---------------------------------------------
+
+typedef struct {
+    BiTreeSync *map;
+    Workload work;
+    uint64_t lookups;
+    Histogram hist;
+} SyncReader;
+
+static void* sync_reader(void *arg) {
+    SyncReader *reader = arg;
+    BiTreeSyncReader *handle = BiTreeSync_reader(reader->map);
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < reader->lookups; i++) {
+        make_key(&reader->work, lookup_index(&reader->work), key);
+        uint64_t start = now_ns();
+        BiTreeSync_contains(handle, key);
+        hist_add(&reader->hist, now_ns() - start, 1);
+    }
+    BiTreeSync_readerRelease(handle);
+    return NULL;
+}
+
+// Aggregate read throughput for 1, 2, 4 .. options.threads readers, each
+// doing the same number of lookups: flat per-thread latency means linear
+// scaling
+static void run_sync(Workload *w) {
+    if (!want(options.ops, "sync_contains")) {
+        return;
+    }
+    BiTreeSync *map = BiTreeSync_new();
+    char key[KEY_MAX];
+    for (uint64_t i = 0; i < w->n; i++) {
+        make_key(w, i, key);
+        BiTreeSync_insert(map, key);
+    }
+
+    for (int threads = 1; threads <= options.threads; threads *= 2) {
+        SyncReader *readers = calloc(threads, sizeof(SyncReader));
+        pthread_t *ids = malloc(threads * sizeof(pthread_t));
+        uint64_t start = now_ns();
+        for (int t = 0; t < threads; t++) {
+            readers[t].map = map;
+            readers[t].work = *w;
+            readers[t].work.rng = w->rng + t + 1;
+            readers[t].lookups = w->lookups;
+            pthread_create(&ids[t], NULL, sync_reader, &readers[t]);
+        }
+        Histogram total = { 0 };
+        for (int t = 0; t < threads; t++) {
+            pthread_join(ids[t], NULL);
+            for (int b = 0; b < HIST_BUCKETS; b++) {
+                total.counts[b] += readers[t].hist.counts[b];
+            }
+            total.ops += readers[t].hist.ops;
+        }
+        // Throughput is over wall time, since the readers overlap
+        total.total_ns = now_ns() - start;
+        report("bitree_sync", "contains", w, threads, &total);
+        free(readers);
+        free(ids);
+    }
+    BiTreeSync_destroy(map);
+}
+
+// --- driver ----------------------------------------------------------------
+
+static void usage(void) {
+    printf("Usage: ./bench [options]\n");
+    printf("  --sizes <n,n,...>    tree sizes (default %s)\n", options.sizes);
+    printf("  --dists <d,d,...>    random,sorted,reverse,zipf,prefix (default all)\n");
+    printf("  --ops <op,op,...>    insert,search_key,search_bfs,search_dfs,search_batch,lookup,search_index,\n");
+    printf("                       splay_lookup,splay_insert,map_incr,map_put,rank,select,delete,insert_batch,\n");
+    printf("                       delete_batch,freeze,frozen_search,serialize,deserialize,snapshot_save,\n");
+    printf("                       snapshot_load,snapshot_load_parallel,btree,radix,idmap,sync_contains\n");
+    printf("                       (default all)\n");
+    printf("  --lookups <n>        lookups per search run, capped at n (default %" PRIu64 ")\n", options.lookups);
+    printf("  --threads <n>        max reader threads for sync_contains, pool size for\n");
+    printf("                       snapshot_load_parallel (default %d)\n", options.threads);
+    printf("  --zipf <s>           skew of the zipf lookups, positive and not 1 (default %.2f)\n", options.zipf);
+    printf("  --format json|csv    output format (default json lines)\n");
+}
+
+int main(int argc, char *argv[]) {
+    for (int i = 1; i < argc; i++) {
+        const char *arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0 || value == NULL) {
+            usage();
+            return strcmp(arg, "--help") == 0 || strcmp(arg, "-h") == 0 ? 0 : 1;
+        }
+        if (strcmp(arg, "--sizes") == 0) {
+            options.sizes = value;
+        } else if (strcmp(arg, "--dists") == 0) {
+            options.dists = value;
+        } else if (strcmp(arg, "--ops") == 0) {
+            options.ops = value;
+        } else if (strcmp(arg, "--lookups") == 0) {
+            options.lookups = strtoull(value, NULL, 10);
+        } else if (strcmp(arg, "--threads") == 0) {
+            options.threads = atoi(value);
+        } else if (strcmp(arg, "--zipf") == 0) {
+            options.zipf = strtod(value, NULL);
+            if (options.zipf <= 0.0 || options.zipf == 1.0) {
+                fprintf(stderr, "--zipf must be positive and not 1\n");
+                return 1;
+            }
+        } else if (strcmp(arg, "--format") == 0) {
+            options.csv = strcmp(value, "csv") == 0;
+        } else {
+            usage();
+            return 1;
+        }
+        i++;
+    }
+
+    for (const char *size = options.sizes; *size != '\0'; ) {
+        uint64_t n = strtoull(size, (char **)&size, 10);
+        if (*size == ',') {
+            size++;
+        }
+        if (n == 0) {
+            continue;
+        }
+        for (int d = 0; d < DIST_COUNT; d++) {
+            if (!want(options.dists, dist_names[d])) {
+                continue;
+            }
+            Workload w;
+            memset(&w, 0, sizeof(w));
+            w.dist = (Dist)d;
+            w.n = n;
+            w.lookups = options.lookups < n ? options.lookups : n;
+            w.zipf_base = pow((double)n + 1.0, 1.0 - options.zipf) - 1.0;
+            w.rng = 42;
+            run_bitree(&w);
+            run_btree(&w);
+            run_radix(&w);
+            run_idmap(&w);
+            run_sync(&w);
+        }
+    }
+    return 0;
+}
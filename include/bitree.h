@@ -5,24 +5,135 @@
 #include <string.h>
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 
 
+// Keys shorter than this are stored inside the node itself
+#define BITREE_INLINE_KEY 18
+
+// Number of interleaved descents in BiTree_searchBatch
+#define BITREE_BATCH_WIDTH 8
+
+// Ancestors a cursor can remember. AVL trees stay below this height up to
+// ~2^44 keys; deeper paths, which splay mode can build, still work but
+// each step re-descends from root.
+#define BITREE_CURSOR_DEPTH 64
+
+// In splay mode, lookups that find their key within this many levels
+// below the root leave the tree alone; deeper ones splay it to the root
+#define BITREE_SPLAY_DEPTH 8
+
+// Current BiTree_saveSnapshot file format version
+#define BITREE_SNAPSHOT_VERSION 3
+
+// Keys per independently checksummed chunk of a snapshot
+#define BITREE_SNAPSHOT_CHUNK 16384
+
+// Current BiTreeFrozen_save file format version
+#define BITREE_FROZEN_VERSION 1
+
+// Buckets of the BiTreeStats depth histogram; the last one also counts
+// every deeper descent
+#define BITREE_STATS_DEPTHS 64
+
+// BiTreeNode.flags
+#define BITREE_NODE_ARENA   0x01  // node memory belongs to a tree arena
+#define BITREE_NODE_HEAPKEY 0x02  // data was strdup'd and must be freed
+#define BITREE_NODE_FRESH   0x04  // private copy of an in-progress BiTreeSync write
+
+// Value stored with a key by the map calls (BiTree_put, BiTree_getOrInsert)
+typedef union {
+    void *ptr;
+    uint64_t u64;
+    int64_t i64;
+    double f64;
+} BiTreeValue;
+
 typedef struct BiTreeNode BiTreeNode;
 struct BiTreeNode {
-    int key;
-    char *data;
+    uint64_t prefix;        // first 8 key bytes, big-endian and zero padded
+    char *data;             // points at inline_data for short keys
     BiTreeNode *left;
     BiTreeNode *right;
+    BiTreeValue value;      // zero until set through the map calls
+    uint32_t size;          // nodes in the subtree rooted here (leaf = 1), so
+                            // a tree holds at most UINT32_MAX keys
+    unsigned char height;   // AVL height of the subtree rooted here (leaf = 1)
+    unsigned char flags;
+    char inline_data[BITREE_INLINE_KEY];
 };
 
+// Per-tree slab allocator for nodes and long key bytes (opaque)
+typedef struct BiTreeArena BiTreeArena;
+
+// Hash table from keys to the nodes holding them (opaque)
+typedef struct BiTreeIndex BiTreeIndex;
+
 typedef struct BiTree BiTree;
 
+// Counters behind BiTree_stats. The per-operation ones are only kept when
+// the library is built with BITREE_STATS (make STATS=1); otherwise they
+// stay zero and cost nothing.
+typedef struct {
+    size_t node_count;          // live nodes
+    size_t bytes;               // arena blocks, hash index and any mapped snapshot file
+    uint64_t blocks;            // arena blocks malloc'd so far
+    int height;                 // current tree height
+
+    uint64_t node_allocs;       // nodes handed out, recycled ones included
+    uint64_t node_frees;        // nodes given back to the arena
+    uint64_t inserts;           // tree-level operations
+    uint64_t deletes;
+    uint64_t lookups;
+    uint64_t comparisons;       // key comparisons made by those operations
+    uint64_t visited;           // nodes they visited
+    uint64_t depths[BITREE_STATS_DEPTHS];   // operations by nodes on their path
+} BiTreeStats;
+
+// Trees made by BiTree_new allocate nodes from their arena and must be
+// mutated through the tree-level calls (BiTree_insert, BiTree_delete).
+// A tree with arena == NULL owns individually malloc'd nodes.
 struct BiTree {
     BiTreeNode *root;
     size_t node_count;
+    BiTreeArena *arena;
+    BiTreeStats *stats;     // operation counters, NULL unless built with BITREE_STATS
+    BiTreeIndex *index;     // exact-match index, NULL unless BiTree_enableIndex
+    bool splay;             // self-adjusting instead of AVL, see BiTree_setSplay
 };
 
+// Ordered iterator over a tree. It lives on the caller's stack and never
+// allocates. Any insert or delete invalidates open cursors on that tree.
+typedef struct {
+    BiTreeNode *root;
+    BiTreeNode *node;                           // current position, NULL at the ends
+    int depth;                                  // ancestors in stack, -1 if they did not fit
+    BiTreeNode *stack[BITREE_CURSOR_DEPTH];     // path from root down to node's parent
+} BiTreeCursor;
+
+// Called for each node visited by a scan; return false to stop early
+typedef bool (*BiTree_visit)(BiTreeNode *node, void *ctx);
+
+// Read-only copy of a tree as flat arrays in Eytzinger (implicit BFS)
+// order, with the keys packed in one string pool. Built by BiTree_freeze
+// or mapped straight from a file written by BiTreeFrozen_save (opaque).
+typedef struct BiTreeFrozen BiTreeFrozen;
+
+// Called for each key visited by a frozen scan; return false to stop early
+typedef bool (*BiTreeFrozen_visit)(const char *key, void *ctx);
+
 BiTree* BiTree_new(const char* root_data);
+BiTree* BiTree_buildSorted(const char **keys, size_t n);
+BiTree* BiTree_buildSortedFile(const char *path);
+bool BiTree_insert(BiTree *tree, const char *data);
+bool BiTree_delete(BiTree *tree, const char *key);
+bool BiTree_setSplay(BiTree *tree, bool splay);
+bool BiTree_get(BiTree *tree, const char *key, BiTreeValue *value);
+bool BiTree_put(BiTree *tree, const char *key, BiTreeValue value);
+BiTreeValue* BiTree_getOrInsert(BiTree *tree, const char *key, bool *inserted);
+bool BiTree_remove(BiTree *tree, const char *key, BiTreeValue *value);
+size_t BiTree_insertBatch(BiTree *tree, const char **keys, size_t n, bool sorted);
+size_t BiTree_deleteBatch(BiTree *tree, const char **keys, size_t n, bool sorted);
 BiTree* BiTree_bfs(BiTreeNode *root, char *data);
 BiTree* BiTree_dfs(BiTreeNode *root, char *data, char *type);
 BiTreeNode* BiTree_createNode(const char* data);
@@ -31,17 +142,57 @@ BiTreeNode* BiTree_deleteNode(BiTreeNode* root, const char* key);
 BiTreeNode* BiTree_minValueNode(BiTreeNode* node);
 BiTreeNode* BiTree_maxValueNode(BiTreeNode* node);
 
+// Deprecated: first node of a "preorder", "inorder" or "postorder"
+// traversal; iterate with the cursor calls or BiTree_range instead
 BiTreeNode* BiTree_reorder(BiTreeNode *root, char *type);
 BiTree* BiTree_search(BiTreeNode *root, char *data, char *type);
+BiTreeNode* BiTree_find(BiTreeNode *root, const char *key);
+BiTreeNode* BiTree_lookup(BiTree *tree, const char *key);
+bool BiTree_enableIndex(BiTree *tree);
+void BiTree_disableIndex(BiTree *tree);
+size_t BiTree_searchBatch(BiTreeNode *root, const char **keys, size_t n, BiTreeNode **out);
+
+size_t BiTree_size(const BiTree *tree);
+size_t BiTree_rank(BiTreeNode *root, const char *key);
+BiTreeNode* BiTree_select(BiTreeNode *root, size_t k);
+size_t BiTree_countRange(BiTreeNode *root, const char *lo, const char *hi);
+
+void BiTree_cursorInit(BiTreeCursor *cursor, BiTreeNode *root);
+BiTreeNode* BiTree_cursorFirst(BiTreeCursor *cursor);
+BiTreeNode* BiTree_cursorLast(BiTreeCursor *cursor);
+BiTreeNode* BiTree_cursorSeek(BiTreeCursor *cursor, const char *key);
+BiTreeNode* BiTree_cursorNext(BiTreeCursor *cursor);
+BiTreeNode* BiTree_cursorPrev(BiTreeCursor *cursor);
+size_t BiTree_range(BiTreeNode *root, const char *lo, const char *hi, BiTree_visit visit, void *ctx);
+size_t BiTree_prefixScan(BiTreeNode *root, const char *prefix, BiTree_visit visit, void *ctx);
 
 bool BiTree_isfull(BiTreeNode *root);
 bool BiTree_iscomplete(BiTreeNode *root);
 
 int BiTree_depth(BiTreeNode* root);
 
+// Preorder records of "<value> <length> <key>", "#" for an empty subtree
 void BiTree_serialize(FILE *fp, BiTreeNode* root, const char* algo);
 BiTreeNode* BiTree_deserialize(FILE *fp);
 
+// Loading a snapshot keeps one node per key in memory, with the keys left
+// in the mapped file; BiTree_verifySnapshot checks one in bounded memory
+bool BiTree_saveSnapshot(const BiTree *tree, const char *path);
+BiTree* BiTree_loadSnapshot(const char *path);
+bool BiTree_verifySnapshot(const char *path);
+
+BiTreeFrozen* BiTree_freeze(const BiTree *tree);
+const char* BiTreeFrozen_find(const BiTreeFrozen *frozen, const char *key);
+const char* BiTreeFrozen_seek(const BiTreeFrozen *frozen, const char *key);
+size_t BiTreeFrozen_range(const BiTreeFrozen *frozen, const char *lo, const char *hi, BiTreeFrozen_visit visit, void *ctx);
+size_t BiTreeFrozen_size(const BiTreeFrozen *frozen);
+bool BiTreeFrozen_save(const BiTreeFrozen *frozen, const char *path);
+BiTreeFrozen* BiTreeFrozen_open(const char *path, bool verify);
+void BiTreeFrozen_destroy(BiTreeFrozen *frozen);
+
+bool BiTree_stats(const BiTree *tree, BiTreeStats *stats);
+void BiTree_statsReset(BiTree *tree);
+
 void BiTree_destroy(BiTree* tree);
 void BiTree_free(BiTreeNode *root);
 #endif // BITREE_H
@@ -0,0 +1,42 @@
+#ifndef BITREE_LOG_H
+#define BITREE_LOG_H
+
+#include "bitree.h"
+
+// Active log size at which a write starts a background compaction
+#define BITREE_LOG_COMPACT_BYTES (64u << 20)
+
+// Current write-ahead log file format version
+#define BITREE_LOG_VERSION 2
+
+// Durable map: a binary snapshot at path plus an append-only log of the
+// writes made since, in path.wal; keys and values both survive. Every
+// write is appended to the log before it returns. Concurrent writers
+// share one write and one fsync per group (group commit). Compaction freezes the log as
+// path.wal.1 and folds it into a new snapshot on a background thread.
+typedef struct BiTreeLog BiTreeLog;
+
+// Open or create the log at path, replaying the snapshot and the log
+// segments. With durable set each write waits for fdatasync; otherwise it
+// only reaches the OS and BiTreeLog_sync makes it durable.
+BiTreeLog* BiTreeLog_open(const char *path, bool durable);
+bool BiTreeLog_close(BiTreeLog *log);
+
+// Writes return true if the tree changed. Once a log write fails every
+// later write returns false; the tree may then be ahead of the log.
+bool BiTreeLog_insert(BiTreeLog *log, const char *key);
+bool BiTreeLog_delete(BiTreeLog *log, const char *key);
+
+// Map writes add the key if it is missing and log the value it ends up
+// with. They return false only if the write was not logged.
+bool BiTreeLog_put(BiTreeLog *log, const char *key, BiTreeValue value);
+bool BiTreeLog_incr(BiTreeLog *log, const char *key, int64_t delta, int64_t *result);
+bool BiTreeLog_get(BiTreeLog *log, const char *key, BiTreeValue *value);
+bool BiTreeLog_contains(BiTreeLog *log, const char *key);
+size_t BiTreeLog_size(BiTreeLog *log);
+
+bool BiTreeLog_sync(BiTreeLog *log);
+bool BiTreeLog_compact(BiTreeLog *log);
+void BiTreeLog_setCompactBytes(BiTreeLog *log, uint64_t bytes);
+void BiTreeLog_waitCompaction(BiTreeLog *log);
+#endif // BITREE_LOG_H
@@ -0,0 +1,17 @@
+#ifndef BITREE_PARALLEL_H
+#define BITREE_PARALLEL_H
+
+#include "bitree.h"
+#include "taskpool.h"
+
+// Whole-tree operations split at subtree boundaries and run on a TaskPool.
+// Each returns exactly what its sequential counterpart in bitree.h does.
+
+void BiTree_freeParallel(TaskPool *pool, BiTreeNode *root);
+void BiTree_destroyParallel(TaskPool *pool, BiTree *tree);
+int BiTree_depthParallel(TaskPool *pool, BiTreeNode *root);
+bool BiTree_isfullParallel(TaskPool *pool, BiTreeNode *root);
+bool BiTree_iscompleteParallel(TaskPool *pool, BiTreeNode *root);
+void BiTree_serializeParallel(TaskPool *pool, FILE *fp, BiTreeNode *root, const char *algo);
+BiTree* BiTree_loadSnapshotParallel(TaskPool *pool, const char *path);
+#endif // BITREE_PARALLEL_H
@@ -0,0 +1,49 @@
+#ifndef BITREE_SYNC_H
+#define BITREE_SYNC_H
+
+#include "bitree.h"
+
+// Maximum number of reader handles registered on one map at a time
+#define BITREE_SYNC_MAX_READERS 128
+
+// Concurrent ordered map. Writers copy the root-to-leaf path they change
+// and publish a new root atomically, so a published tree is never modified
+// in place. Readers pin the current root and walk it without locks; nodes
+// replaced by writers are freed only after every reader that could still
+// see them has unpinned (epoch-based reclamation).
+typedef struct BiTreeSync BiTreeSync;
+
+// Per-thread reader registration. A handle must not be shared between
+// threads and pins do not nest.
+typedef struct BiTreeSyncReader BiTreeSyncReader;
+
+// Reference-counted snapshot of one version of the map. Unlike a pin it may
+// be held for long (checkpoints, backups, analytics scans) and passed
+// between threads; writers never wait for it.
+typedef struct BiTreeSyncVersion BiTreeSyncVersion;
+
+BiTreeSync* BiTreeSync_new(void);
+void BiTreeSync_destroy(BiTreeSync *map);
+
+bool BiTreeSync_insert(BiTreeSync *map, const char *key);
+bool BiTreeSync_delete(BiTreeSync *map, const char *key);
+size_t BiTreeSync_size(BiTreeSync *map);
+
+BiTreeSyncReader* BiTreeSync_reader(BiTreeSync *map);
+void BiTreeSync_readerRelease(BiTreeSyncReader *reader);
+
+// Pin returns the current root; it and every node below it stay valid and
+// unchanged until unpin, so any read-only BiTree call may be used on it
+BiTreeNode* BiTreeSync_pin(BiTreeSyncReader *reader);
+void BiTreeSync_unpin(BiTreeSyncReader *reader);
+
+bool BiTreeSync_contains(BiTreeSyncReader *reader, const char *key);
+size_t BiTreeSync_range(BiTreeSyncReader *reader, const char *lo, const char *hi, BiTree_visit visit, void *ctx);
+
+BiTreeSyncVersion* BiTreeSync_snapshot(BiTreeSync *map);
+BiTreeSyncVersion* BiTreeSync_versionAcquire(BiTreeSyncVersion *version);
+void BiTreeSync_versionRelease(BiTreeSyncVersion *version);
+BiTreeNode* BiTreeSync_versionRoot(const BiTreeSyncVersion *version);
+size_t BiTreeSync_versionSize(const BiTreeSyncVersion *version);
+bool BiTreeSync_saveVersion(const BiTreeSyncVersion *version, const char *path);
+#endif // BITREE_SYNC_H
@@ -0,0 +1,53 @@
+#ifndef BTREE_H
+#define BTREE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Maximum number of keys per node. The prefix array of a full node spans
+// four 64-byte cache lines and is what the in-node search touches first.
+#define BTREE_ORDER 32
+#define BTREE_MIN_KEYS (BTREE_ORDER / 2)
+
+typedef struct BTreeNode BTreeNode;
+struct BTreeNode {
+    uint64_t prefix[BTREE_ORDER];   // first 8 key bytes, big-endian, per key
+    char *keys[BTREE_ORDER];        // leaf keys, or separators in inner nodes
+    int nkeys;
+    bool leaf;
+    union {
+        BTreeNode *children[BTREE_ORDER + 1];  // inner nodes
+        struct {
+            BTreeNode *prev;                   // leaves, in key order
+            BTreeNode *next;
+        } link;
+    };
+};
+
+typedef struct BTree BTree;
+struct BTree {
+    BTreeNode *root;
+    BTreeNode *first;   // leftmost leaf, start of ordered scans
+    size_t count;
+    int height;
+};
+
+// Called for each key visited by BTree_scan; return false to stop early
+typedef bool (*BTree_visit)(const char *key, void *ctx);
+
+BTree* BTree_new(void);
+bool BTree_insert(BTree *tree, const char *key);
+bool BTree_delete(BTree *tree, const char *key);
+const char* BTree_search(const BTree *tree, const char *key);
+size_t BTree_scan(const BTree *tree, const char *lo, const char *hi, BTree_visit visit, void *ctx);
+
+int BTree_depth(const BTree *tree);
+
+void BTree_serialize(FILE *fp, const BTree *tree);
+BTree* BTree_deserialize(FILE *fp);
+
+void BTree_destroy(BTree *tree);
+#endif // BTREE_H
@@ -0,0 +1,280 @@
+#ifndef MAP_GEN_H
+#define MAP_GEN_H
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdbool.h>
+
+// Code generator for ordered maps specialized on a key type, a value type
+// and a comparator. MAP_GENERATE(IdMap, uint64_t, void *, MAP_CMP_NUMBER)
+// expands to an AVL map type IdMap with static inline functions
+// IdMap_new, IdMap_put, IdMap_get, ... in which keys are stored by value
+// and compared with the inlined comparator: no formatting, strdup or
+// strcmp. cmp(a, b) takes two lvalues of the key type and returns <0, 0
+// or >0; it may be a macro or a function.
+//
+//   MAP_GENERATE(IdMap, uint64_t, double, MAP_CMP_NUMBER)
+//
+//   IdMap *map = IdMap_new();
+//   IdMap_put(map, 42, 1.5);
+//   double *value = IdMap_get(map, 42);
+//   IdMap_destroy(map);
+
+// Comparator for integer and floating point keys
+#define MAP_CMP_NUMBER(a, b) (((a) > (b)) - ((a) < (b)))
+
+// Comparator for fixed-size keys ordered by their bytes (structs without
+// padding, byte arrays wrapped in a struct)
+#define MAP_CMP_BYTES(a, b) memcmp(&(a), &(b), sizeof(a))
+
+// Nodes per allocation block of a generated map
+#define MAP_BLOCK_NODES 256
+
+// Bound on the height of any AVL tree that fits in memory
+#define MAP_MAX_HEIGHT 96
+
+#define MAP_GENERATE(name, K, V, cmp) \
+typedef struct name##Node name##Node; \
+struct name##Node { \
+    K key; \
+    V value; \
+    name##Node *left; \
+    name##Node *right; \
+    int height; \
+}; \
+\
+typedef struct name##Block name##Block; \
+struct name##Block { \
+    name##Block *next; \
+    name##Node nodes[MAP_BLOCK_NODES]; \
+}; \
+\
+/* Nodes are carved from blocks and recycled through a free list */ \
+typedef struct { \
+    name##Node *root; \
+    size_t count; \
+    name##Node *free_nodes;     /* linked through ->right */ \
+    name##Block *blocks;        /* newest first */ \
+    size_t block_used;          /* nodes handed out from blocks */ \
+} name; \
+\
+/* Called for each entry in key order; return false to stop early */ \
+typedef bool (*name##_visit)(const K *key, V *value, void *ctx); \
+\
+static inline name* name##_new(void) { \
+    name *map = calloc(1, sizeof(name)); \
+    if (map == NULL) { \
+        fprintf(stderr, "Failed to create a new " #name "\n"); \
+    } \
+    return map; \
+} \
+\
+static inline void name##_destroy(name *map) { \
+    if (map == NULL) { \
+        return; \
+    } \
+    name##Block *block = map->blocks; \
+    while (block != NULL) { \
+        name##Block *next = block->next; \
+        free(block); \
+        block = next; \
+    } \
+    free(map); \
+} \
+\
+static inline size_t name##_size(const name *map) { \
+    return map == NULL ? 0 : map->count; \
+} \
+\
+static inline name##Node* name##_allocNode(name *map) { \
+    name##Node *node = map->free_nodes; \
+    if (node != NULL) { \
+        map->free_nodes = node->right; \
+        return node; \
+    } \
+    if (map->blocks == NULL || map->block_used == MAP_BLOCK_NODES) { \
+        name##Block *block = malloc(sizeof(name##Block)); \
+        if (block == NULL) { \
+            fprintf(stderr, "Memory allocation failed for " #name " node.\n"); \
+            exit(EXIT_FAILURE); \
+        } \
+        block->next = map->blocks; \
+        map->blocks = block; \
+        map->block_used = 0; \
+    } \
+    return &map->blocks->nodes[map->block_used++]; \
+} \
+\
+static inline int name##_nodeHeight(const name##Node *node) { \
+    return node == NULL ? 0 : node->height; \
+} \
+\
+static inline void name##_nodeUpdate(name##Node *node) { \
+    int lh = name##_nodeHeight(node->left); \
+    int rh = name##_nodeHeight(node->right); \
+    node->height = 1 + (lh > rh ? lh : rh); \
+} \
+\
+static inline name##Node* name##_rotateRight(name##Node *node) { \
+    name##Node *pivot = node->left; \
+    node->left = pivot->right; \
+    pivot->right = node; \
+    name##_nodeUpdate(node); \
+    name##_nodeUpdate(pivot); \
+    return pivot; \
+} \
+\
+static inline name##Node* name##_rotateLeft(name##Node *node) { \
+    name##Node *pivot = node->right; \
+    node->right = pivot->left; \
+    pivot->left = node; \
+    name##_nodeUpdate(node); \
+    name##_nodeUpdate(pivot); \
+    return pivot; \
+} \
+\
+static inline name##Node* name##_rebalance(name##Node *node) { \
+    name##_nodeUpdate(node); \
+    int balance = name##_nodeHeight(node->left) - name##_nodeHeight(node->right); \
+    if (balance > 1) { \
+        if (name##_nodeHeight(node->left->left) < name##_nodeHeight(node->left->right)) { \
+            node->left = name##_rotateLeft(node->left); \
+        } \
+        return name##_rotateRight(node); \
+    } \
+    if (balance < -1) { \
+        if (name##_nodeHeight(node->right->right) < name##_nodeHeight(node->right->left)) { \
+            node->right = name##_rotateRight(node->right); \
+        } \
+        return name##_rotateLeft(node); \
+    } \
+    return node; \
+} \
+\
+static inline name##Node* name##_insertRec(name *map, name##Node *node, K *key, V *value, bool *inserted) { \
+    if (node == NULL) { \
+        node = name##_allocNode(map); \
+        node->key = *key; \
+        node->value = *value; \
+        node->left = NULL; \
+        node->right = NULL; \
+        node->height = 1; \
+        *inserted = true; \
+        return node; \
+    } \
+    int c = cmp(*key, node->key); \
+    if (c < 0) { \
+        node->left = name##_insertRec(map, node->left, key, value, inserted); \
+    } else if (c > 0) { \
+        node->right = name##_insertRec(map, node->right, key, value, inserted); \
+    } else { \
+        node->value = *value; /* Existing key: overwrite in place */ \
+        return node; \
+    } \
+    return *inserted ? name##_rebalance(node) : node; \
+} \
+\
+static inline name##Node* name##_detachMin(name##Node *node, name##Node **min) { \
+    if (node->left == NULL) { \
+        *min = node; \
+        return node->right; \
+    } \
+    node->left = name##_detachMin(node->left, min); \
+    return name##_rebalance(node); \
+} \
+\
+static inline name##Node* name##_removeRec(name *map, name##Node *node, K *key, V *value, bool *removed) { \
+    if (node == NULL) { \
+        return NULL; \
+    } \
+    int c = cmp(*key, node->key); \
+    if (c < 0) { \
+        node->left = name##_removeRec(map, node->left, key, value, removed); \
+    } else if (c > 0) { \
+        node->right = name##_removeRec(map, node->right, key, value, removed); \
+    } else { \
+        name##Node *replacement; \
+        if (node->left == NULL) { \
+            replacement = node->right; \
+        } else if (node->right == NULL) { \
+            replacement = node->left; \
+        } else { \
+            name##Node *successor; \
+            name##Node *right = name##_detachMin(node->right, &successor); \
+            successor->left = node->left; \
+            successor->right = right; \
+            replacement = name##_rebalance(successor); \
+        } \
+        if (value != NULL) { \
+            *value = node->value; \
+        } \
+        node->right = map->free_nodes; \
+        map->free_nodes = node; \
+        *removed = true; \
+        return replacement; \
+    } \
+    return *removed ? name##_rebalance(node) : node; \
+} \
+\
+/* Insert key or overwrite its value; returns true if the key is new */ \
+static inline bool name##_put(name *map, K key, V value) { \
+    bool inserted = false; \
+    map->root = name##_insertRec(map, map->root, &key, &value, &inserted); \
+    if (inserted) { \
+        map->count++; \
+    } \
+    return inserted; \
+} \
+\
+/* Pointer to the value stored for key, or NULL. Valid until the next put \
+   or remove on the map. */ \
+static inline V* name##_get(name *map, K key) { \
+    name##Node *node = map->root; \
+    while (node != NULL) { \
+        int c = cmp(key, node->key); \
+        if (c == 0) { \
+            return &node->value; \
+        } \
+        node = c < 0 ? node->left : node->right; \
+    } \
+    return NULL; \
+} \
+\
+static inline bool name##_contains(name *map, K key) { \
+    return name##_get(map, key) != NULL; \
+} \
+\
+/* Remove key, storing its value in *value unless value is NULL; returns \
+   true if the key was present */ \
+static inline bool name##_remove(name *map, K key, V *value) { \
+    bool removed = false; \
+    map->root = name##_removeRec(map, map->root, &key, value, &removed); \
+    if (removed) { \
+        map->count--; \
+    } \
+    return removed; \
+} \
+\
+/* Visit every entry in key order; returns the number visited */ \
+static inline size_t name##_foreach(name *map, name##_visit visit, void *ctx) { \
+    name##Node *stack[MAP_MAX_HEIGHT]; \
+    int top = 0; \
+    size_t visited = 0; \
+    name##Node *node = map->root; \
+    while (node != NULL || top > 0) { \
+        while (node != NULL) { \
+            stack[top++] = node; \
+            node = node->left; \
+        } \
+        node = stack[--top]; \
+        visited++; \
+        if (!visit(&node->key, &node->value, ctx)) { \
+            break; \
+        } \
+        node = node->right; \
+    } \
+    return visited; \
+}
+
+#endif // MAP_GEN_H
@@ -0,0 +1,49 @@
+#ifndef RADIX_H
+#define RADIX_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Compressed radix (Patricia) tree of NUL terminated string keys. Every
+// node holds the label of the edge leading into it, so a prefix shared by
+// many keys is stored once and a lookup reads each key byte once instead
+// of running log n strcmp calls over the shared part. Children are sorted
+// by the first byte of their label, so a depth first walk yields the keys
+// in strcmp order.
+typedef struct RadixNode RadixNode;
+struct RadixNode {
+    RadixNode **children;   // capacity child slots, then capacity first label bytes
+    uint32_t length;        // label bytes
+    uint16_t nchildren;
+    uint16_t capacity;
+    bool terminal;          // a key ends at this node
+    unsigned char label[];
+};
+
+// The root has an empty label and is never removed. Every other node either
+// ends a key or has at least two children.
+typedef struct Radix Radix;
+struct Radix {
+    RadixNode *root;
+    size_t count;
+    size_t bytes;           // malloc'd by the nodes and their child arrays
+};
+
+// Called for each key visited by a scan; return false to stop early. The key
+// is rebuilt in a scratch buffer and is only valid during the call.
+typedef bool (*Radix_visit)(const char *key, void *ctx);
+
+Radix* Radix_new(void);
+bool Radix_insert(Radix *tree, const char *key);
+bool Radix_delete(Radix *tree, const char *key);
+bool Radix_search(const Radix *tree, const char *key);
+size_t Radix_scan(const Radix *tree, const char *lo, const char *hi, Radix_visit visit, void *ctx);
+size_t Radix_prefixScan(const Radix *tree, const char *prefix, Radix_visit visit, void *ctx);
+
+int Radix_depth(const Radix *tree);
+
+void Radix_destroy(Radix *tree);
+#endif // RADIX_H
@@ -0,0 +1,28 @@
+#ifndef TASKPOOL_H
+#define TASKPOOL_H
+
+#include <stdlib.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+
+// Fixed set of worker threads running fork-join tasks. Every worker owns a
+// deque: it pushes and pops its own tasks at the back and idle workers
+// steal the oldest task from the front of someone else's.
+typedef struct TaskPool TaskPool;
+
+typedef void (*TaskPool_fn)(void *arg);
+
+// Tasks spawned into one group can be waited for together
+typedef struct {
+    atomic_size_t pending;
+} TaskGroup;
+
+#define TASKGROUP_INIT { 0 }
+
+TaskPool* TaskPool_new(int threads);
+void TaskPool_destroy(TaskPool *pool);
+int TaskPool_threads(const TaskPool *pool);
+
+void TaskPool_spawn(TaskPool *pool, TaskGroup *group, TaskPool_fn fn, void *arg);
+void TaskPool_wait(TaskPool *pool, TaskGroup *group);
+#endif // TASKPOOL_H
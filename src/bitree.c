@@ -1,4 +1,299 @@
 #include "bitree.h"
+#include "bitree_internal.h"
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Node slabs start small and double up to this many nodes per block
+#define ARENA_MIN_NODES 64
+#define ARENA_MAX_NODES 8192
+// Size of the blocks long keys are carved from
+#define ARENA_KEY_BLOCK 16384
+
+typedef struct ArenaBlock ArenaBlock;
+struct ArenaBlock {
+    ArenaBlock *next;
+    size_t used;
+    size_t capacity;
+    _Alignas(BiTreeNode) unsigned char bytes[];
+};
+
+struct BiTreeArena {
+    ArenaBlock *nodes;          // node slabs, newest first
+    ArenaBlock *keys;           // long key storage, newest first
+    BiTreeNode *free_nodes;     // recycled nodes, linked through ->right
+    size_t next_nodes;          // node capacity of the next slab
+    void *map;                  // snapshot file the node keys point into
+    size_t map_size;
+    size_t bytes;               // malloc'd by the blocks above
+    uint64_t blocks;
+};
+
+static void* map_file(const char *path, size_t *size, bool sequential);
+static void unmap_file(void *map, size_t size);
+
+static ArenaBlock* arena_block(BiTreeArena *arena, ArenaBlock *next, size_t capacity) {
+    ArenaBlock *block = malloc(sizeof(ArenaBlock) + capacity);
+    if (block == NULL) {
+        return NULL;
+    }
+    arena->bytes += sizeof(ArenaBlock) + capacity;
+    arena->blocks++;
+    block->next = next;
+    block->used = 0;
+    block->capacity = capacity;
+    return block;
+}
+
+static BiTreeArena* arena_new(void) {
+    BiTreeArena *arena = malloc(sizeof(BiTreeArena));
+    if (arena == NULL) {
+        return NULL;
+    }
+    arena->nodes = NULL;
+    arena->keys = NULL;
+    arena->free_nodes = NULL;
+    arena->next_nodes = ARENA_MIN_NODES;
+    arena->map = NULL;
+    arena->map_size = 0;
+    arena->bytes = 0;
+    arena->blocks = 0;
+    return arena;
+}
+
+static void arena_destroy(BiTreeArena *arena) {
+    ArenaBlock *lists[2] = { arena->nodes, arena->keys };
+    for (int i = 0; i < 2; i++) {
+        ArenaBlock *block = lists[i];
+        while (block != NULL) {
+            ArenaBlock *next = block->next;
+            free(block);
+            block = next;
+        }
+    }
+    if (arena->map != NULL) {
+        unmap_file(arena->map, arena->map_size);
+    }
+    free(arena);
+}
+
+static BiTreeNode* arena_node(BiTreeArena *arena) {
+    if (arena->free_nodes != NULL) {
+        BiTreeNode *node = arena->free_nodes;
+        arena->free_nodes = node->right;
+        return node;
+    }
+
+    ArenaBlock *block = arena->nodes;
+    if (block == NULL || block->used + sizeof(BiTreeNode) > block->capacity) {
+        block = arena_block(arena, arena->nodes, arena->next_nodes * sizeof(BiTreeNode));
+        if (block == NULL) {
+            return NULL;
+        }
+        arena->nodes = block;
+        if (arena->next_nodes < ARENA_MAX_NODES) {
+            arena->next_nodes *= 2;
+        }
+    }
+    BiTreeNode *node = (BiTreeNode *)(block->bytes + block->used);
+    block->used += sizeof(BiTreeNode);
+    return node;
+}
+
+// Carve count nodes from one dedicated block so they sit back to back
+static BiTreeNode* arena_nodes(BiTreeArena *arena, size_t count) {
+    ArenaBlock *block = arena_block(arena, NULL, count * sizeof(BiTreeNode));
+    if (block == NULL) {
+        return NULL;
+    }
+    block->used = block->capacity;
+    // Keep the bump block at the head of the list
+    if (arena->nodes != NULL) {
+        block->next = arena->nodes->next;
+        arena->nodes->next = block;
+    } else {
+        arena->nodes = block;
+    }
+    return (BiTreeNode *)block->bytes;
+}
+
+// Copy a long key of length bytes plus a terminating NUL into arena storage.
+// The bytes live until the arena is destroyed; deleting the node does not
+// give them back.
+static char* arena_key(BiTreeArena *arena, const char *data, size_t length) {
+    size_t size = length + 1;
+    char *key;
+    ArenaBlock *block = arena->keys;
+    if (block == NULL || block->used + size > block->capacity) {
+        if (size > ARENA_KEY_BLOCK / 4) {
+            // Oversized keys get a private block behind the current one
+            ArenaBlock *own = arena_block(arena, block != NULL ? block->next : NULL, size);
+            if (own == NULL) {
+                return NULL;
+            }
+            if (block != NULL) {
+                block->next = own;
+            } else {
+                arena->keys = own;
+            }
+            own->used = size;
+            key = (char *)own->bytes;
+            memcpy(key, data, length);
+            key[length] = '\0';
+            return key;
+        }
+        block = arena_block(arena, arena->keys, ARENA_KEY_BLOCK);
+        if (block == NULL) {
+            return NULL;
+        }
+        arena->keys = block;
+    }
+    key = (char *)block->bytes + block->used;
+    block->used += size;
+    memcpy(key, data, length);
+    key[length] = '\0';
+    return key;
+}
+
+#ifdef BITREE_STATS
+// Bump a BiTreeStats counter of tree; node-level calls pass no tree
+#define STATS_ADD(tree, field, n) \
+    do { \
+        if ((tree) != NULL && (tree)->stats != NULL) { \
+            (tree)->stats->field += (n); \
+        } \
+    } while (0)
+
+// Visited count when a tree-level operation starts
+#define STATS_BEGIN(tree) ((tree)->stats != NULL ? (tree)->stats->visited : 0)
+
+// Count a finished operation and the length of the path it walked
+#define STATS_END(tree, op, start) \
+    do { \
+        if ((tree)->stats != NULL) { \
+            uint64_t path = (tree)->stats->visited - (start); \
+            (tree)->stats->op++; \
+            (tree)->stats->depths[path < BITREE_STATS_DEPTHS ? path : BITREE_STATS_DEPTHS - 1]++; \
+        } \
+    } while (0)
+#else
+#define STATS_ADD(tree, field, n) ((void)(tree))
+#define STATS_BEGIN(tree) 0
+#define STATS_END(tree, op, start) ((void)(start))
+#endif
+
+// Point an arena node at a copy of data[0..length): inline when it fits,
+// otherwise in the arena key blocks
+static bool node_set_key(BiTreeArena *arena, BiTreeNode *node, const char *data, size_t length) {
+    if (length < BITREE_INLINE_KEY) {
+        memcpy(node->inline_data, data, length);
+        node->inline_data[length] = '\0';
+        node->data = node->inline_data;
+    } else {
+        node->data = arena_key(arena, data, length);
+        if (node->data == NULL) {
+            return false;
+        }
+    }
+    node->prefix = key_prefix(node->data);
+    return true;
+}
+
+// Add a freshly allocated node to the tree's hash index, if it keeps one.
+// An index that cannot grow is dropped; lookups then fall back to the tree.
+static BiTreeNode* node_index(BiTree *tree, BiTreeNode *node) {
+    if (node != NULL && tree != NULL && tree->index != NULL && !bitree_index_put(tree->index, node)) {
+        fprintf(stderr, "%s\n", "Failed to grow the BiTree index, dropping it");
+        BiTree_disableIndex(tree);
+    }
+    return node;
+}
+
+// Allocate and initialize a node, from the tree's arena when it has one
+static BiTreeNode* node_alloc(BiTree *tree, const char *data) {
+    BiTreeArena *arena = tree != NULL ? tree->arena : NULL;
+    STATS_ADD(tree, node_allocs, 1);
+    if (arena == NULL) {
+        return node_index(tree, BiTree_createNode(data));
+    }
+
+    BiTreeNode *node = arena_node(arena);
+    if (node == NULL) {
+        return NULL;
+    }
+    if (!node_set_key(arena, node, data, strlen(data))) {
+        node->right = arena->free_nodes;
+        arena->free_nodes = node;
+        return NULL;
+    }
+    node->value.u64 = 0;
+    node->height = 1;
+    node->size = 1;
+    node->left = NULL;
+    node->right = NULL;
+    node->flags = BITREE_NODE_ARENA;
+    return node_index(tree, node);
+}
+
+// Release a node unlinked from the tree
+static void node_release(BiTree *tree, BiTreeNode *node) {
+    STATS_ADD(tree, node_frees, 1);
+    if (tree != NULL && tree->index != NULL) {
+        bitree_index_remove(tree->index, node);
+    }
+    if (node->flags & BITREE_NODE_HEAPKEY) {
+        free(node->data);
+    }
+    if (!(node->flags & BITREE_NODE_ARENA)) {
+        free(node);
+    } else if (tree != NULL && tree->arena != NULL) {
+        node->right = tree->arena->free_nodes;
+        tree->arena->free_nodes = node;
+    }
+    // Arena nodes unlinked without their tree are reclaimed with the arena
+}
+
+// Link count nodes, already in key order, into a perfectly balanced
+// subtree in O(count) and return its root
+static BiTreeNode* build_balanced(BiTreeNode *nodes, size_t count) {
+    if (count == 0) {
+        return NULL;
+    }
+    size_t mid = count / 2;
+    BiTreeNode *root = &nodes[mid];
+    root->left = build_balanced(nodes, mid);
+    root->right = build_balanced(nodes + mid + 1, count - mid - 1);
+    node_update(root);
+    return root;
+}
+
+// Restore the AVL invariant at node after one of its subtrees changed height
+static BiTreeNode* rebalance(BiTreeNode *node) {
+    node_update(node);
+    int balance = node_height(node->left) - node_height(node->right);
+
+    if (balance > 1) {
+        // Left-right case: straighten the left child first
+        if (node_height(node->left->left) < node_height(node->left->right)) {
+            node->left = rotate_left(node->left);
+        }
+        return rotate_right(node);
+    }
+    if (balance < -1) {
+        // Right-left case: straighten the right child first
+        if (node_height(node->right->right) < node_height(node->right->left)) {
+            node->right = rotate_right(node->right);
+        }
+        return rotate_left(node);
+    }
+    return node;
+}
 
 BiTree* BiTree_new(const char* root_data) {
   // Allocate memory for the tree
@@ -7,21 +302,39 @@ BiTree* BiTree_new(const char* root_data) {
     fprintf(stderr, "%s\n", "Failed to create a new BiTree");
     return NULL;
   }
+  tree->root = NULL;
+  tree->node_count = 0;
+  tree->stats = NULL;
+  tree->index = NULL;
+  tree->splay = false;
+  tree->arena = arena_new();
+  if (tree->arena == NULL) {
+    fprintf(stderr, "%s\n", "Failed to create a node arena for BiTree");
+    free(tree);
+    return NULL;
+  }
+#ifdef BITREE_STATS
+  tree->stats = calloc(1, sizeof(BiTreeStats));
+  if (tree->stats == NULL) {
+    fprintf(stderr, "%s\n", "Failed to create statistics for BiTree");
+    BiTree_destroy(tree);
+    return NULL;
+  }
+#endif
+
+  // A NULL root_data creates an empty tree
+  if (root_data == NULL) {
+    return tree;
+  }
 
   // Allocate memory for the root node
-  BiTreeNode *root = malloc(sizeof(BiTreeNode));
+  BiTreeNode *root = node_alloc(tree, root_data);
   if (root == NULL) {
     fprintf(stderr, "%s\n", "Failed to create a node for BiTree");
-    free(tree); // Free previously allocated memory for tree
+    BiTree_destroy(tree); // Free previously allocated memory for tree
     return NULL;
   }
 
-  // Initialize the root node
-  root->key = 0;  // Assuming initial key/index is 0
-  root->data = strdup(root_data); // Duplicate the string for data
-  root->left = NULL;
-  root->right = NULL;
-
   // Set the root of the tree
   tree->root = root;
   tree->node_count = 1;
@@ -29,70 +342,612 @@ BiTree* BiTree_new(const char* root_data) {
   return tree;
 };
 
-BiTreeNode* BiTree_insertNode(BiTreeNode *current, const char *data) {
-    // If the tree is empty, create a new node as the root
+// Recursive AVL insert; *inserted is set when a new node was linked in and
+// *found receives the node holding data, new or not (NULL if it could not
+// be allocated)
+static BiTreeNode* insert_rec(BiTree *tree, BiTreeNode *current, const char *data, uint64_t prefix,
+                              BiTreeNode **found, bool *inserted) {
+    // Empty subtree: the new node becomes its root
     if (current == NULL) {
-        return BiTree_createNode(data);
+        BiTreeNode *node = node_alloc(tree, data);
+        *found = node;
+        *inserted = node != NULL;
+        return node;
     }
 
-    // If the data is less than the current node's data, go left
-    if (strcmp(data, current->data) < 0) {
-        current->left = BiTree_insertNode(current->left, data);
-    }
-    // If the data is greater than the current node's data, go right
-    else if (strcmp(data, current->data) > 0) {
-        current->right = BiTree_insertNode(current->right, data);
+    STATS_ADD(tree, visited, 1);
+    STATS_ADD(tree, comparisons, 1);
+    int cmp = node_cmp(current, prefix, data);
+    if (cmp < 0) {
+        current->left = insert_rec(tree, current->left, data, prefix, found, inserted);
+    } else if (cmp > 0) {
+        current->right = insert_rec(tree, current->right, data, prefix, found, inserted);
+    } else {
+        *found = current;
+        return current; // Duplicate keys are ignored
     }
 
-    // Return the unchanged node pointer
-    return current;
+    return *inserted ? rebalance(current) : current;
 }
 
-BiTreeNode* BiTree_deleteNode(BiTreeNode* root, const char* key) {
-    // Base case: If the tree is empty, return NULL
+// Detach the minimum node of a non-empty subtree; the detached node is stored in *min
+static BiTreeNode* detach_min(BiTree *tree, BiTreeNode *node, BiTreeNode **min) {
+    STATS_ADD(tree, visited, 1);
+    if (node->left == NULL) {
+        *min = node;
+        return node->right;
+    }
+    node->left = detach_min(tree, node->left, min);
+    return rebalance(node);
+}
+
+// Recursive AVL delete; *removed is set when a node was unlinked and freed,
+// after its value was copied to *value if that is not NULL
+static BiTreeNode* delete_rec(BiTree *tree, BiTreeNode *root, const char *key, uint64_t prefix,
+                              BiTreeValue *value, bool *removed) {
+    // Base case: key not present in this subtree
     if (root == NULL) {
         return NULL;
     }
 
-    // Traverse the tree to find the node with the specified key
-    if (strcmp(root->data, key) > 0) {
-        root->left = BiTree_deleteNode(root->left, key);
-    } else if (strcmp(root->data, key) < 0) {
-        root->right = BiTree_deleteNode(root->right, key);
+    STATS_ADD(tree, visited, 1);
+    STATS_ADD(tree, comparisons, 1);
+    int cmp = node_cmp(root, prefix, key);
+    if (cmp < 0) {
+        root->left = delete_rec(tree, root->left, key, prefix, value, removed);
+    } else if (cmp > 0) {
+        root->right = delete_rec(tree, root->right, key, prefix, value, removed);
     } else {
-        // Case 1: Node to be deleted has no children
-        if (root->left == NULL && root->right == NULL) {
-            free(root->data);
-            free(root);
-            root = NULL;
-        }
-        // Case 2: Node to be deleted has one child
-        else if (root->left == NULL) {
-            BiTreeNode* temp = root;
-            root = root->right;
-            free(temp->data);
-            free(temp);
+        BiTreeNode *replacement;
+        if (root->left == NULL) {
+            // Zero or one child: splice the node out
+            replacement = root->right;
         } else if (root->right == NULL) {
-            BiTreeNode* temp = root;
-            root = root->left;
-            free(temp->data);
-            free(temp);
+            replacement = root->left;
+        } else {
+            // Two children: relink the inorder successor into this position.
+            // Nodes keep their own keys, so no key bytes are copied around.
+            BiTreeNode *successor;
+            BiTreeNode *right = detach_min(tree, root->right, &successor);
+            successor->left = root->left;
+            successor->right = right;
+            replacement = rebalance(successor);
+        }
+        if (value != NULL) {
+            *value = root->value;
+        }
+        node_release(tree, root);
+        *removed = true;
+        return replacement;
+    }
+
+    return *removed ? rebalance(root) : root;
+}
+
+// Top-down splay: bring the node holding key, or the last node on its
+// search path, to the root of the subtree in one pass. Nodes peeled off on
+// the way hang on the right spine of a tree of smaller keys and the left
+// spine of a tree of greater keys; their subtree sizes are fixed up along
+// those spines at the end, so rank and select keep working in splay mode.
+static BiTreeNode* splay(BiTree *tree, BiTreeNode *root, const char *key, uint64_t prefix) {
+    if (root == NULL) {
+        return NULL;
+    }
+    BiTreeNode header;
+    header.left = NULL;
+    header.right = NULL;
+    BiTreeNode *smaller = &header;  // maximum of the tree of smaller keys
+    BiTreeNode *greater = &header;  // minimum of the tree of greater keys
+    size_t smaller_size = 0;
+    size_t greater_size = 0;
+    BiTreeNode *current = root;
+
+    for (;;) {
+        STATS_ADD(tree, visited, 1);
+        STATS_ADD(tree, comparisons, 1);
+        int cmp = node_cmp(current, prefix, key);
+        if (cmp < 0) {
+            if (current->left == NULL) {
+                break;
+            }
+            STATS_ADD(tree, comparisons, 1);
+            if (node_cmp(current->left, prefix, key) < 0) {
+                // Zig-zig: rotate the left child up before linking it
+                BiTreeNode *child = current->left;
+                current->left = child->right;
+                child->right = current;
+                current->size = 1 + node_size(current->left) + node_size(current->right);
+                current = child;
+                if (current->left == NULL) {
+                    break;
+                }
+            }
+            greater->left = current;
+            greater = current;
+            greater_size += 1 + node_size(current->right);
+            current = current->left;
+        } else if (cmp > 0) {
+            if (current->right == NULL) {
+                break;
+            }
+            STATS_ADD(tree, comparisons, 1);
+            if (node_cmp(current->right, prefix, key) > 0) {
+                // Zag-zag: rotate the right child up before linking it
+                BiTreeNode *child = current->right;
+                current->right = child->left;
+                child->left = current;
+                current->size = 1 + node_size(current->left) + node_size(current->right);
+                current = child;
+                if (current->right == NULL) {
+                    break;
+                }
+            }
+            smaller->right = current;
+            smaller = current;
+            smaller_size += 1 + node_size(current->left);
+            current = current->right;
+        } else {
+            break;
+        }
+    }
+
+    smaller_size += node_size(current->left);
+    greater_size += node_size(current->right);
+    current->size = smaller_size + greater_size + 1;
+    smaller->right = NULL;
+    greater->left = NULL;
+    for (BiTreeNode *node = header.right; node != NULL; node = node->right) {
+        node->size = smaller_size;
+        smaller_size -= 1 + node_size(node->left);
+    }
+    for (BiTreeNode *node = header.left; node != NULL; node = node->left) {
+        node->size = greater_size;
+        greater_size -= 1 + node_size(node->right);
+    }
+
+    // Reassemble with current on top
+    smaller->right = current->left;
+    greater->left = current->right;
+    current->left = header.right;
+    current->right = header.left;
+    return current;
+}
+
+// Splay-mode insert: splay the key up, then split the root around a new
+// node that becomes the root. *found receives the node holding data as in
+// insert_rec.
+static bool splay_insert(BiTree *tree, const char *data, uint64_t prefix, BiTreeNode **found) {
+    BiTreeNode *root = splay(tree, tree->root, data, prefix);
+    tree->root = root;
+    int cmp = root != NULL ? node_cmp(root, prefix, data) : 0;
+    if (root != NULL && cmp == 0) {
+        *found = root;
+        return false; // Duplicate keys are ignored
+    }
+    BiTreeNode *node = node_alloc(tree, data);
+    *found = node;
+    if (node == NULL) {
+        return false;
+    }
+    if (root != NULL) {
+        if (cmp < 0) {
+            node->left = root->left;
+            node->right = root;
+            root->left = NULL;
+        } else {
+            node->right = root->right;
+            node->left = root;
+            root->right = NULL;
+        }
+        root->size = 1 + node_size(root->left) + node_size(root->right);
+        node->size = 1 + node_size(node->left) + node_size(node->right);
+    }
+    tree->root = node;
+    return true;
+}
+
+// Splay-mode delete: splay the key up and join its two subtrees. Every key
+// on the left is smaller, so splaying the left subtree for the same key
+// brings up its maximum, which has no right child to lose.
+static bool splay_delete(BiTree *tree, const char *key, uint64_t prefix, BiTreeValue *value) {
+    BiTreeNode *root = splay(tree, tree->root, key, prefix);
+    tree->root = root;
+    if (root == NULL || node_cmp(root, prefix, key) != 0) {
+        return false;
+    }
+    BiTreeNode *replacement = root->right;
+    if (root->left != NULL) {
+        replacement = splay(tree, root->left, key, prefix);
+        replacement->right = root->right;
+        replacement->size += node_size(root->right);
+    }
+    if (value != NULL) {
+        *value = root->value;
+    }
+    node_release(tree, root);
+    tree->root = replacement;
+    return true;
+}
+
+BiTreeNode* BiTree_insertNode(BiTreeNode *current, const char *data) {
+    BiTreeNode *found;
+    bool inserted = false;
+    return insert_rec(NULL, current, data, key_prefix(data), &found, &inserted);
+}
+
+BiTreeNode* BiTree_deleteNode(BiTreeNode* root, const char* key) {
+    bool removed = false;
+    return delete_rec(NULL, root, key, key_prefix(key), NULL, &removed);
+}
+
+// Tree-level insert shared by BiTree_insert and the map calls; *found
+// receives the node holding data
+static bool insert_key(BiTree *tree, const char *data, BiTreeNode **found) {
+    uint64_t start = STATS_BEGIN(tree);
+    bool inserted = false;
+    if (tree->splay) {
+        inserted = splay_insert(tree, data, key_prefix(data), found);
+    } else {
+        tree->root = insert_rec(tree, tree->root, data, key_prefix(data), found, &inserted);
+    }
+    if (inserted) {
+        tree->node_count++;
+    }
+    STATS_END(tree, inserts, start);
+    return inserted;
+}
+
+// Tree-level delete shared by BiTree_delete and BiTree_remove
+static bool delete_key(BiTree *tree, const char *key, BiTreeValue *value) {
+    uint64_t start = STATS_BEGIN(tree);
+    bool removed = false;
+    if (tree->splay) {
+        removed = splay_delete(tree, key, key_prefix(key), value);
+    } else {
+        tree->root = delete_rec(tree, tree->root, key, key_prefix(key), value, &removed);
+    }
+    if (removed) {
+        tree->node_count--;
+    }
+    STATS_END(tree, deletes, start);
+    return removed;
+}
+
+// Insert data into the tree, returns true if a new node was added
+bool BiTree_insert(BiTree *tree, const char *data) {
+    if (tree == NULL || data == NULL) {
+        return false;
+    }
+    BiTreeNode *found;
+    return insert_key(tree, data, &found);
+}
+
+// Remove key from the tree, returns true if a node was removed
+bool BiTree_delete(BiTree *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    return delete_key(tree, key, NULL);
+}
+
+// Map calls. Every key carries a BiTreeValue, zero until set. Nodes never
+// move and keep their key bytes for life, so a value is updated in place
+// and an existing key is never copied again. Snapshots store each value
+// after its key and BiTree_serialize writes it as an integer in front of
+// the key's length and bytes; frozen trees store only the keys.
+
+// Function to read the value stored with key. Returns false, leaving
+// *value alone, if the key is not in the tree.
+bool BiTree_get(BiTree *tree, const char *key, BiTreeValue *value) {
+    BiTreeNode *node = BiTree_lookup(tree, key);
+    if (node == NULL) {
+        return false;
+    }
+    if (value != NULL) {
+        *value = node->value;
+    }
+    return true;
+}
+
+// Function to find key, adding it with a zero value if missing, in one
+// descent, and return its value slot. The slot stays valid until the key
+// is removed, so a counter is bumped with slot->u64++. *inserted, if not
+// NULL, tells whether the key was added. Returns NULL if the key had to be
+// added and could not.
+BiTreeValue* BiTree_getOrInsert(BiTree *tree, const char *key, bool *inserted) {
+    if (inserted != NULL) {
+        *inserted = false;
+    }
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    BiTreeNode *node = NULL;
+    if (tree->index != NULL) {
+        // Hits, most of a counter workload, skip the descent altogether
+        node = BiTree_lookup(tree, key);
+    }
+    if (node == NULL) {
+        bool added = insert_key(tree, key, &node);
+        if (inserted != NULL) {
+            *inserted = added;
         }
-        // Case 3: Node to be deleted has two children
-        else {
-            // Find the inorder successor (smallest node in the right subtree)
-            BiTreeNode* temp = BiTree_minValueNode(root->right);
+    }
+    return node != NULL ? &node->value : NULL;
+}
+
+// Function to store value under key, adding the key if missing, in one
+// descent. Returns false if the key had to be added and could not.
+bool BiTree_put(BiTree *tree, const char *key, BiTreeValue value) {
+    BiTreeValue *slot = BiTree_getOrInsert(tree, key, NULL);
+    if (slot == NULL) {
+        return false;
+    }
+    *slot = value;
+    return true;
+}
+
+// Function to remove key in one descent, copying its value to *value if
+// that is not NULL. Returns false if the key was not in the tree.
+bool BiTree_remove(BiTree *tree, const char *key, BiTreeValue *value) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    return delete_key(tree, key, value);
+}
+
+
+// Batch updates merge a sorted run of keys into the tree in one descent:
+// each node splits the run around its key and hands the halves to its
+// children, so the upper levels are compared once per batch instead of
+// once per key.
+typedef struct {
+    uint64_t prefix;
+    const char *key;
+} BatchKey;
+
+static int batch_order(const void *a, const void *b) {
+    const BatchKey *x = a;
+    const BatchKey *y = b;
+    if (x->prefix != y->prefix) {
+        return x->prefix < y->prefix ? -1 : 1;
+    }
+    return (x->prefix & 0xff) == 0 ? 0 : strcmp(x->key + 8, y->key + 8);
+}
 
-            // Copy the inorder successor's data to this node
-            strcpy(root->data, temp->data);
+// Copy keys into a sorted batch without duplicates. With sorted set the
+// keys are only checked, not sorted. Returns NULL on failure.
+static BatchKey* batch_prepare(const char **keys, size_t n, bool sorted, size_t *count) {
+    BatchKey *batch = malloc(n * sizeof(BatchKey));
+    if (batch == NULL) {
+        fprintf(stderr, "Memory allocation failed for batch update.\n");
+        return NULL;
+    }
+    for (size_t i = 0; i < n; i++) {
+        batch[i].prefix = key_prefix(keys[i]);
+        batch[i].key = keys[i];
+    }
+    if (!sorted) {
+        qsort(batch, n, sizeof(BatchKey), batch_order);
+    }
+    size_t distinct = 0;
+    for (size_t i = 0; i < n; i++) {
+        int cmp = distinct > 0 ? batch_order(&batch[distinct - 1], &batch[i]) : -1;
+        if (cmp > 0) {
+            fprintf(stderr, "Batch input is not sorted at \"%s\"\n", batch[i].key);
+            free(batch);
+            return NULL;
+        }
+        if (cmp < 0) {
+            batch[distinct++] = batch[i];
+        }
+    }
+    *count = distinct;
+    return batch;
+}
 
-            // Delete the inorder successor
-            root->right = BiTree_deleteNode(root->right, temp->data);
+// Index of the first batch key >= node's key
+static size_t batch_split(BiTree *tree, const BiTreeNode *node, const BatchKey *batch, size_t n) {
+    size_t lo = 0, hi = n;
+    while (lo < hi) {
+        size_t mid = lo + (hi - lo) / 2;
+        STATS_ADD(tree, comparisons, 1);
+        if (node_cmp(node, batch[mid].prefix, batch[mid].key) < 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
     }
+    return lo;
+}
+
+// Link count nodes, already in key order, into a perfectly balanced subtree
+static BiTreeNode* link_balanced(BiTreeNode **nodes, size_t count) {
+    if (count == 0) {
+        return NULL;
+    }
+    size_t mid = count / 2;
+    BiTreeNode *root = nodes[mid];
+    root->left = link_balanced(nodes, mid);
+    root->right = link_balanced(nodes + mid + 1, count - mid - 1);
+    node_update(root);
+    return root;
+}
+
+// Link the first count nodes of a vine, a list in key order through the
+// right pointers, into a perfectly balanced subtree as link_balanced does.
+// *vine moves past the nodes used.
+static BiTreeNode* link_vine(BiTreeNode **vine, size_t count) {
+    if (count == 0) {
+        return NULL;
+    }
+    size_t mid = count / 2;
+    BiTreeNode *left = link_vine(vine, mid);
+    BiTreeNode *root = *vine;
+    *vine = root->right;
+    root->left = left;
+    root->right = link_vine(vine, count - mid - 1);
+    node_update(root);
     return root;
 }
 
+// Rebalance node after a batch changed its subtrees. Children that differ
+// in height by up to 2 take the usual AVL rotations; anything further out
+// of balance is rebuilt in place, like a scapegoat tree does. The rebuild
+// rotates the subtree into a vine first, so it needs no memory.
+static BiTreeNode* batch_rebalance(BiTreeNode *node) {
+    node_update(node);
+    int balance = node_height(node->left) - node_height(node->right);
+    if (balance >= -2 && balance <= 2) {
+        return rebalance(node);
+    }
+    size_t count = node->size;
+    BiTreeNode *vine = NULL;
+    BiTreeNode **tail = &vine;
+    while (node != NULL) {
+        if (node->left != NULL) {
+            BiTreeNode *left = node->left;
+            node->left = left->right;
+            left->right = node;
+            node = left;
+        } else {
+            *tail = node;
+            tail = &node->right;
+            node = node->right;
+        }
+    }
+    return link_vine(&vine, count);
+}
+
+// Balanced subtree of new nodes for a run of keys that lands on an empty
+// child. Once an allocation fails (*failed) the rest of the batch is
+// dropped; the keys added so far stay in a valid tree and are counted in
+// *inserted.
+static BiTreeNode* batch_build(BiTree *tree, const BatchKey *batch, size_t n, size_t *inserted, bool *failed) {
+    if (n == 0 || *failed) {
+        return NULL;
+    }
+    size_t mid = n / 2;
+    BiTreeNode *node = node_alloc(tree, batch[mid].key);
+    if (node == NULL) {
+        fprintf(stderr, "Memory allocation failed for batch insert.\n");
+        *failed = true;
+        return NULL;
+    }
+    (*inserted)++;
+    node->left = batch_build(tree, batch, mid, inserted, failed);
+    node->right = batch_build(tree, batch + mid + 1, n - mid - 1, inserted, failed);
+    if (*failed) {
+        return batch_rebalance(node); // A partial build may be lopsided
+    }
+    node_update(node);
+    return node;
+}
+
+static BiTreeNode* insert_batch_rec(BiTree *tree, BiTreeNode *node, const BatchKey *batch, size_t n,
+                                    size_t *inserted, bool *failed) {
+    if (n == 0 || *failed) {
+        return node;
+    }
+    if (node == NULL) {
+        return batch_build(tree, batch, n, inserted, failed);
+    }
+    STATS_ADD(tree, visited, 1);
+    size_t split = batch_split(tree, node, batch, n);
+    bool match = split < n && node_cmp(node, batch[split].prefix, batch[split].key) == 0;
+    size_t before = *inserted;
+    node->left = insert_batch_rec(tree, node->left, batch, split, inserted, failed);
+    node->right = insert_batch_rec(tree, node->right, batch + split + match, n - split - match, inserted, failed);
+    return *inserted > before ? batch_rebalance(node) : node;
+}
+
+static BiTreeNode* delete_batch_rec(BiTree *tree, BiTreeNode *node, const BatchKey *batch, size_t n, size_t *removed) {
+    if (n == 0 || node == NULL) {
+        return node;
+    }
+    STATS_ADD(tree, visited, 1);
+    size_t split = batch_split(tree, node, batch, n);
+    bool match = split < n && node_cmp(node, batch[split].prefix, batch[split].key) == 0;
+    size_t before = *removed;
+    node->left = delete_batch_rec(tree, node->left, batch, split, removed);
+    node->right = delete_batch_rec(tree, node->right, batch + split + match, n - split - match, removed);
+    if (!match) {
+        return *removed > before ? batch_rebalance(node) : node;
+    }
+
+    // Splice the node out as delete_rec does
+    BiTreeNode *replacement;
+    if (node->left == NULL) {
+        replacement = node->right;
+    } else if (node->right == NULL) {
+        replacement = node->left;
+    } else {
+        BiTreeNode *successor;
+        BiTreeNode *right = detach_min(tree, node->right, &successor);
+        successor->left = node->left;
+        successor->right = right;
+        replacement = batch_rebalance(successor);
+    }
+    node_release(tree, node);
+    (*removed)++;
+    return replacement;
+}
+
+// Insert n keys with one merge-style descent, rebalancing each touched
+// subtree once on the way back up. The keys are sorted first unless sorted
+// is set, in which case they must be in ascending strcmp order (duplicates
+// are fine). Returns the number of keys added; if memory runs out the
+// batch stops there and only the keys counted are in the tree.
+size_t BiTree_insertBatch(BiTree *tree, const char **keys, size_t n, bool sorted) {
+    if (tree == NULL || keys == NULL || n == 0) {
+        return 0;
+    }
+    if (tree->splay) {
+        // Splaying key by key keeps the access order of the batch
+        size_t inserted = 0;
+        for (size_t i = 0; i < n; i++) {
+            inserted += BiTree_insert(tree, keys[i]);
+        }
+        return inserted;
+    }
+    size_t count;
+    BatchKey *batch = batch_prepare(keys, n, sorted, &count);
+    if (batch == NULL) {
+        return 0;
+    }
+    size_t inserted = 0;
+    bool failed = false;
+    tree->root = insert_batch_rec(tree, tree->root, batch, count, &inserted, &failed);
+    tree->node_count += inserted;
+    STATS_ADD(tree, inserts, count);
+    free(batch);
+    return inserted;
+}
+
+// Delete n keys with one merge-style descent; see BiTree_insertBatch.
+// Returns the number of keys removed.
+size_t BiTree_deleteBatch(BiTree *tree, const char **keys, size_t n, bool sorted) {
+    if (tree == NULL || keys == NULL || n == 0) {
+        return 0;
+    }
+    if (tree->splay) {
+        size_t removed = 0;
+        for (size_t i = 0; i < n; i++) {
+            removed += BiTree_delete(tree, keys[i]);
+        }
+        return removed;
+    }
+    size_t count;
+    BatchKey *batch = batch_prepare(keys, n, sorted, &count);
+    if (batch == NULL) {
+        return 0;
+    }
+    size_t removed = 0;
+    tree->root = delete_batch_rec(tree, tree->root, batch, count, &removed);
+    tree->node_count -= removed;
+    STATS_ADD(tree, deletes, count);
+    free(batch);
+    return removed;
+}
 
 BiTreeNode* BiTree_minValueNode(BiTreeNode* node) {
     BiTreeNode* current = node;
@@ -115,16 +970,96 @@ BiTreeNode* BiTree_maxValueNode(BiTreeNode* node) {
 // Function to create a new binary tree node
 BiTreeNode* BiTree_createNode(const char* data) {
     BiTreeNode* newNode = (BiTreeNode*)malloc(sizeof(BiTreeNode));
-    newNode->data = strdup(data); // Duplicate the data string
+    if (newNode == NULL) {
+        return NULL;
+    }
+    size_t size = strlen(data) + 1;
+    if (size <= BITREE_INLINE_KEY) {
+        // Short keys live inside the node, no second allocation
+        newNode->data = memcpy(newNode->inline_data, data, size);
+        newNode->flags = 0;
+    } else {
+        newNode->data = strdup(data); // Duplicate the data string
+        if (newNode->data == NULL) {
+            free(newNode);
+            return NULL;
+        }
+        newNode->flags = BITREE_NODE_HEAPKEY;
+    }
+    newNode->value.u64 = 0;
+    newNode->prefix = key_prefix(data);
+    newNode->height = 1;
+    newNode->size = 1;
     newNode->left = NULL;
     newNode->right = NULL;
     return newNode;
 }
 
+// Wrap a found node in the BiTree* result handed out by the search calls
+static BiTree* subtree_of(BiTreeNode *node) {
+    BiTree *subtree = (BiTree *)malloc(sizeof(BiTree));
+    if (subtree == NULL) {
+        fprintf(stderr, "Memory allocation failed for subtree.\n");
+        exit(EXIT_FAILURE);
+    }
+    subtree->root = node; // Set the root of the subtree
+    subtree->node_count = node->size; // Nodes below and including the match
+    subtree->arena = NULL; // The subtree borrows nodes, it owns nothing
+    subtree->stats = NULL;
+    subtree->index = NULL;
+    subtree->splay = false;
+    return subtree;
+}
+
+// Make room for one more entry in a traversal queue/stack, doubling its capacity
+static BiTreeNode** reserve_nodes(BiTreeNode **nodes, int count, int *capacity, const char *what) {
+    if (count < *capacity) {
+        return nodes;
+    }
+    *capacity = *capacity > 0 ? *capacity * 2 : 16;
+    nodes = (BiTreeNode **)realloc(nodes, *capacity * sizeof(BiTreeNode *));
+    if (nodes == NULL) {
+        fprintf(stderr, "Memory reallocation failed for %s.\n", what);
+        exit(EXIT_FAILURE);
+    }
+    return nodes;
+}
+
+// Inorder walk over a whole tree on a growable stack. Internal passes use
+// it instead of a cursor, whose fixed path falls back to a descent per step
+// on the deep shapes splay mode can build.
+typedef struct {
+    BiTreeNode **stack;         // ancestors still to visit, current node on top
+    int top;
+    int capacity;
+} TreeWalk;
+
+// Push node and its left spine, returning the node now on top
+static BiTreeNode* walk_left(TreeWalk *walk, BiTreeNode *node) {
+    for (; node != NULL; node = node->left) {
+        walk->stack = reserve_nodes(walk->stack, walk->top, &walk->capacity, "walk stack");
+        walk->stack[walk->top++] = node;
+    }
+    return walk->top > 0 ? walk->stack[walk->top - 1] : NULL;
+}
+
+static BiTreeNode* walk_first(TreeWalk *walk, BiTreeNode *root) {
+    walk->stack = NULL;
+    walk->top = 0;
+    walk->capacity = 0;
+    return walk_left(walk, root);
+}
+
+// Step past the node returned last, which must not have been NULL
+static BiTreeNode* walk_next(TreeWalk *walk) {
+    BiTreeNode *node = walk->stack[--walk->top];
+    return walk_left(walk, node->right);
+}
+
 // Function to perform breadth-first search (BFS) traversal
 // Returns a BiTree* containing the subtree where the data is found, or NULL if not found
 BiTree* BiTree_bfs(BiTreeNode *root, char *data) {
-    if (root == NULL) {
+    if (root == NULL || data == NULL) {
         return NULL;
     }
 
@@ -137,6 +1072,7 @@ BiTree* BiTree_bfs(BiTreeNode *root, char *data) {
 
     level_nodes[0] = root; // Initialize the first level with the root node
     int level_count = 1; // Number of nodes at the current level
+    uint64_t prefix = key_prefix(data); // Rules out most nodes without a strcmp
 
     while (level_count > 0) {
         BiTreeNode *found_node = NULL; // Pointer to the node where data is found
@@ -144,33 +1080,26 @@ BiTree* BiTree_bfs(BiTreeNode *root, char *data) {
         // Allocate memory for the array to store nodes at the next level
         BiTreeNode **next_level_nodes = NULL;
         int next_level_count = 0; // Number of nodes at the next level
+        int next_level_capacity = 0;
 
         for (int i = 0; i < level_count; i++) {
             BiTreeNode *current = level_nodes[i];
 
             // Check if the current node matches the specified data
-            if (strcmp(current->data, data) == 0) {
+            if (current->prefix == prefix && node_cmp(current, prefix, data) == 0) {
                 found_node = current;
                 break;
             }
 
             // Add left child to the next level array if it exists
             if (current->left != NULL) {
-                next_level_nodes = (BiTreeNode **)realloc(next_level_nodes, (next_level_count + 1) * sizeof(BiTreeNode *));
-                if (next_level_nodes == NULL) {
-                    fprintf(stderr, "Memory reallocation failed for next level nodes.\n");
-                    exit(EXIT_FAILURE);
-                }
+                next_level_nodes = reserve_nodes(next_level_nodes, next_level_count, &next_level_capacity, "next level nodes");
                 next_level_nodes[next_level_count++] = current->left;
             }
 
             // Add right child to the next level array if it exists
             if (current->right != NULL) {
-                next_level_nodes = (BiTreeNode **)realloc(next_level_nodes, (next_level_count + 1) * sizeof(BiTreeNode *));
-                if (next_level_nodes == NULL) {
-                    fprintf(stderr, "Memory reallocation failed for next level nodes.\n");
-                    exit(EXIT_FAILURE);
-                }
+                next_level_nodes = reserve_nodes(next_level_nodes, next_level_count, &next_level_capacity, "next level nodes");
                 next_level_nodes[next_level_count++] = current->right;
             }
         }
@@ -180,14 +1109,8 @@ BiTree* BiTree_bfs(BiTreeNode *root, char *data) {
 
         // If data is found at current level, create a subtree and return it
         if (found_node != NULL) {
-            BiTree *subtree = (BiTree *)malloc(sizeof(BiTree));
-            if (subtree == NULL) {
-                fprintf(stderr, "Memory allocation failed for subtree.\n");
-                exit(EXIT_FAILURE);
-            }
-            subtree->root = found_node; // Set the root of the subtree
-            subtree->node_count = 1; // Initialize node count
-            return subtree;
+            free(next_level_nodes);
+            return subtree_of(found_node);
         }
 
         // Move to the next level
@@ -201,7 +1124,7 @@ BiTree* BiTree_bfs(BiTreeNode *root, char *data) {
 
 // Function to perform depth-first search (DFS) traversal using a stack
 BiTree* BiTree_dfs(BiTreeNode *root, char *data, char *type) {
-    if (root == NULL) {
+    if (root == NULL || data == NULL) {
         return NULL;  // Base case: If the root is NULL, return NULL
     }
 
@@ -217,45 +1140,32 @@ BiTree* BiTree_dfs(BiTreeNode *root, char *data, char *type) {
         exit(EXIT_FAILURE);
     }
     int top = -1; // Initialize top of stack
+    int capacity = 1;
 
     // Push the root node onto the stack
     stack[++top] = root;
+    uint64_t prefix = key_prefix(data); // Rules out most nodes without a strcmp
 
     while (top >= 0) {
         // Pop the top node from the stack
         BiTreeNode *current = stack[top--];
 
         // Check if the current node matches the specified data
-        if (strcmp(current->data, data) == 0) {
+        if (current->prefix == prefix && node_cmp(current, prefix, data) == 0) {
             free(stack); // Free the memory allocated for the stack
             // Create a new BiTree* containing the subtree where the data is found
-            BiTree *subtree = (BiTree *)malloc(sizeof(BiTree));
-            if (subtree == NULL) {
-                fprintf(stderr, "Memory allocation failed for subtree.\n");
-                exit(EXIT_FAILURE);
-            }
-            subtree->root = current; // Set the root of the subtree
-            subtree->node_count = 1; // Initialize node count
-            return subtree;
+            return subtree_of(current);
         }
 
         // Push the right child onto the stack if it exists
         if (current->right != NULL) {
-            stack = (BiTreeNode **)realloc(stack, (top + 2) * sizeof(BiTreeNode *));
-            if (stack == NULL) {
-                fprintf(stderr, "Memory reallocation failed for stack.\n");
-                exit(EXIT_FAILURE);
-            }
+            stack = reserve_nodes(stack, top + 1, &capacity, "stack");
             stack[++top] = current->right;
         }
 
         // Push the left child onto the stack if it exists
         if (current->left != NULL) {
-            stack = (BiTreeNode **)realloc(stack, (top + 2) * sizeof(BiTreeNode *));
-            if (stack == NULL) {
-                fprintf(stderr, "Memory reallocation failed for stack.\n");
-                exit(EXIT_FAILURE);
-            }
+            stack = reserve_nodes(stack, top + 1, &capacity, "stack");
             stack[++top] = current->left;
         }
     }
@@ -267,32 +1177,28 @@ BiTree* BiTree_dfs(BiTreeNode *root, char *data, char *type) {
 
 
 
-// Function to reorder the binary tree based on the specified traversal type
+// Function to find the node a traversal of the given type starts at: the
+// root for "preorder", the smallest key for "inorder" and the leftmost
+// leaf for "postorder". Kept for existing callers; to walk the keys in
+// order use the cursor calls or BiTree_range.
 BiTreeNode* BiTree_reorder(BiTreeNode* root, char* type) {
     if (root == NULL || type == NULL) {
         return NULL; // Return NULL for invalid input
     }
 
-    // Determine the traversal type
     if (strcmp(type, "preorder") == 0) {
-        // No change needed for preorder traversal
-        return root; // Return the original root
+        return root;
     } else if (strcmp(type, "inorder") == 0) {
-        // Traverse the tree in inorder using BiTree_dfs
-        BiTree* subtree = BiTree_dfs(root, NULL, "inorder");
-        if (subtree != NULL) {
-            return subtree->root; // Return the root of the subtree
-        } else {
-            return NULL; // Return NULL if traversal fails
-        }
+        BiTreeCursor cursor;
+        BiTree_cursorInit(&cursor, root);
+        return BiTree_cursorFirst(&cursor);
     } else if (strcmp(type, "postorder") == 0) {
-        // Traverse the tree in postorder using BiTree_dfs
-        BiTree* subtree = BiTree_dfs(root, NULL, "postorder");
-        if (subtree != NULL) {
-            return subtree->root; // Return the root of the subtree
-        } else {
-            return NULL; // Return NULL if traversal fails
+        // Postorder visits the first leaf reached preferring left children
+        BiTreeNode *node = root;
+        while (node->left != NULL || node->right != NULL) {
+            node = node->left != NULL ? node->left : node->right;
         }
+        return node;
     } else {
         // Unsupported traversal type
         fprintf(stderr, "Unsupported traversal type: %s\n", type);
@@ -308,7 +1214,11 @@ BiTree* BiTree_search(BiTreeNode *root, char *data, char *type) {
     }
 
     // Determine the traversal type
-    if (strcmp(type, "bfs") == 0) {
+    if (strcmp(type, "key") == 0) {
+        // Follow the key order from the root: O(log n), no traversal buffers
+        BiTreeNode *found = BiTree_find(root, data);
+        return found != NULL ? subtree_of(found) : NULL;
+    } else if (strcmp(type, "bfs") == 0) {
         // Perform BFS traversal
         return BiTree_bfs(root, data);
     } else if (strcmp(type, "dfs") == 0) {
@@ -322,22 +1232,458 @@ BiTree* BiTree_search(BiTreeNode *root, char *data, char *type) {
 }
 
 
-// Function to calculate the depth of a binary tree
+// Descend from root along the search order, counting into tree's stats
+static BiTreeNode* find_node(BiTree *tree, BiTreeNode *root, const char *key) {
+    BiTreeNode *current = root;
+    uint64_t prefix = key_prefix(key);
+    while (current != NULL) {
+        STATS_ADD(tree, visited, 1);
+        STATS_ADD(tree, comparisons, 1);
+        int cmp = node_cmp(current, prefix, key);
+        if (cmp == 0) {
+            return current;
+        }
+        current = cmp < 0 ? current->left : current->right;
+    }
+    return NULL;
+}
+
+// Function to look up a key by descending along the search order.
+// Returns the matching node, or NULL if the key is not in the tree.
+BiTreeNode* BiTree_find(BiTreeNode *root, const char *key) {
+    return find_node(NULL, root, key);
+}
+
+// Function to look up a key in a tree; same as BiTree_find, but the
+// lookup shows up in the tree's statistics and is answered from the hash
+// index when the tree keeps one. Otherwise a tree in splay mode splays the
+// key to the root.
+BiTreeNode* BiTree_lookup(BiTree *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    uint64_t start = STATS_BEGIN(tree);
+    BiTreeNode *found;
+    if (tree->index != NULL) {
+        size_t probes;
+        found = bitree_index_get(tree->index, key, key_prefix(key), &probes);
+        STATS_ADD(tree, visited, probes);
+        STATS_ADD(tree, comparisons, probes);
+    } else if (tree->splay) {
+        // A key found near the root stays where it is, so lookups of hot
+        // keys are read-only and do not keep pushing each other down
+        uint64_t prefix = key_prefix(key);
+        int depth = 0;
+        found = tree->root;
+        while (found != NULL) {
+            STATS_ADD(tree, visited, 1);
+            STATS_ADD(tree, comparisons, 1);
+            int cmp = node_cmp(found, prefix, key);
+            if (cmp == 0) {
+                break;
+            }
+            depth++;
+            found = cmp < 0 ? found->left : found->right;
+        }
+        if (depth > BITREE_SPLAY_DEPTH) {
+            tree->root = splay(tree, tree->root, key, prefix);
+        }
+    } else {
+        found = find_node(tree, tree->root, key);
+    }
+    STATS_END(tree, lookups, start);
+    return found;
+}
+
+// Function to attach a hash index to a tree so BiTree_lookup finds exact
+// keys in O(1) expected time. Ordered operations keep using the tree.
+// Insert and delete (single or batch) keep the index in sync; nodes keep
+// their keys for life, so the index never has to follow a key around.
+// Returns false if the index could not be allocated.
+bool BiTree_enableIndex(BiTree *tree) {
+    if (tree == NULL) {
+        return false;
+    }
+    if (tree->index != NULL) {
+        return true;
+    }
+    BiTreeIndex *index = bitree_index_new(tree->node_count);
+    if (index == NULL) {
+        fprintf(stderr, "%s\n", "Failed to create an index for BiTree");
+        return false;
+    }
+    TreeWalk walk;
+    for (BiTreeNode *node = walk_first(&walk, tree->root); node != NULL; node = walk_next(&walk)) {
+        bitree_index_put(index, node); // Sized for node_count, never grows here
+    }
+    free(walk.stack);
+    tree->index = index;
+    return true;
+}
+
+// Function to switch a tree between AVL balancing and self-adjusting splay
+// mode. In splay mode BiTree_insert, BiTree_delete and BiTree_lookup splay
+// the key they touch to the root, so frequently used keys stay near the
+// top and a run of lookups costs about the entropy of the access pattern.
+// Lookups then restructure the tree like writes do. Switching back to AVL
+// relinks the nodes into a perfectly balanced tree in O(n). Returns false
+// if that rebuild could not allocate; the tree then stays in splay mode.
+bool BiTree_setSplay(BiTree *tree, bool splay) {
+    if (tree == NULL) {
+        return false;
+    }
+    if (tree->splay && !splay && tree->root != NULL) {
+        BiTreeNode **nodes = malloc(tree->node_count * sizeof(BiTreeNode *));
+        if (nodes == NULL) {
+            fprintf(stderr, "%s\n", "Failed to rebuild BiTree after splay mode");
+            return false;
+        }
+        // Rotate left children onto the right spine and collect it; unlike
+        // a recursive walk this is safe on the degenerate shapes splaying
+        // can leave behind
+        size_t count = 0;
+        BiTreeNode *node = tree->root;
+        while (node != NULL) {
+            if (node->left != NULL) {
+                BiTreeNode *left = node->left;
+                node->left = left->right;
+                left->right = node;
+                node = left;
+            } else {
+                nodes[count++] = node;
+                node = node->right;
+            }
+        }
+        tree->root = link_balanced(nodes, count);
+        free(nodes);
+    }
+    tree->splay = splay;
+    return true;
+}
+
+// Function to drop the hash index of a tree, if it has one
+void BiTree_disableIndex(BiTree *tree) {
+    if (tree != NULL) {
+        bitree_index_destroy(tree->index);
+        tree->index = NULL;
+    }
+}
+
+// Function to look up n keys at once. Descents run BITREE_BATCH_WIDTH at a
+// time in lockstep: each round advances every pending lookup by one level
+// and prefetches the next node, so the cache misses of one lookup overlap
+// with the comparisons of the others. out[i] receives the node for keys[i]
+// or NULL. Returns the number of keys found.
+size_t BiTree_searchBatch(BiTreeNode *root, const char **keys, size_t n, BiTreeNode **out) {
+    size_t found = 0;
+
+    for (size_t base = 0; base < n; base += BITREE_BATCH_WIDTH) {
+        size_t width = n - base < BITREE_BATCH_WIDTH ? n - base : BITREE_BATCH_WIDTH;
+        BiTreeNode *current[BITREE_BATCH_WIDTH];
+        uint64_t prefixes[BITREE_BATCH_WIDTH];
+        size_t pending = 0;
+
+        for (size_t j = 0; j < width; j++) {
+            current[j] = root;
+            prefixes[j] = key_prefix(keys[base + j]);
+            out[base + j] = NULL;
+            if (root != NULL) {
+                pending++;
+            }
+        }
+
+        while (pending > 0) {
+            for (size_t j = 0; j < width; j++) {
+                BiTreeNode *node = current[j];
+                if (node == NULL) {
+                    continue;
+                }
+                int cmp = node_cmp(node, prefixes[j], keys[base + j]);
+                if (cmp == 0) {
+                    out[base + j] = node;
+                    found++;
+                    node = NULL;
+                } else {
+                    node = cmp < 0 ? node->left : node->right;
+                }
+                if (node != NULL) {
+                    __builtin_prefetch(node);
+                } else {
+                    pending--;
+                }
+                current[j] = node;
+            }
+        }
+    }
+    return found;
+}
+
+// Function to return the number of keys in a tree in O(1)
+size_t BiTree_size(const BiTree *tree) {
+    return tree == NULL ? 0 : tree->node_count;
+}
+
+// Number of keys below key, or up to and including it when inclusive.
+// One descent: every step right skips the left subtree and the node.
+static size_t count_below(BiTreeNode *root, const char *key, bool inclusive) {
+    uint64_t prefix = key_prefix(key);
+    size_t count = 0;
+    BiTreeNode *current = root;
+    while (current != NULL) {
+        int cmp = node_cmp(current, prefix, key);
+        if (cmp < 0 || (cmp == 0 && !inclusive)) {
+            current = current->left;
+        } else {
+            count += node_size(current->left) + 1;
+            if (cmp == 0) {
+                break;
+            }
+            current = current->right;
+        }
+    }
+    return count;
+}
+
+// Function to return the number of keys strictly less than key, which is
+// also the 0-based position key has or would have in key order
+size_t BiTree_rank(BiTreeNode *root, const char *key) {
+    return key == NULL ? 0 : count_below(root, key, false);
+}
+
+// Function to return the node with the k-th smallest key (0-based), or
+// NULL if the tree has k keys or fewer
+BiTreeNode* BiTree_select(BiTreeNode *root, size_t k) {
+    BiTreeNode *current = root;
+    while (current != NULL) {
+        size_t left = node_size(current->left);
+        if (k == left) {
+            return current;
+        }
+        if (k < left) {
+            current = current->left;
+        } else {
+            k -= left + 1;
+            current = current->right;
+        }
+    }
+    return NULL;
+}
+
+// Function to count the keys in [lo, hi] in O(log n); a NULL bound is open
+size_t BiTree_countRange(BiTreeNode *root, const char *lo, const char *hi) {
+    size_t upto = hi != NULL ? count_below(root, hi, true) : node_size(root);
+    size_t below = lo != NULL ? count_below(root, lo, false) : 0;
+    return upto > below ? upto - below : 0;
+}
+
+// Bound searched for by cursor_descend
+typedef enum {
+    SEEK_GE,    // first key >= target
+    SEEK_GT,    // first key > target
+    SEEK_LE,    // last key <= target
+    SEEK_LT     // last key < target
+} SeekMode;
+
+// Position the cursor on the node matching mode relative to key, recording
+// the descent path as it goes. The ancestors of the match are a prefix of
+// that path, so the stack is simply cut back to the match.
+static BiTreeNode* cursor_descend(BiTreeCursor *cursor, const char *key, SeekMode mode) {
+    BiTreeNode *match = NULL;
+    int match_depth = 0;
+    int depth = 0;
+    uint64_t prefix = key_prefix(key);
+
+    for (BiTreeNode *current = cursor->root; current != NULL; depth++) {
+        if (depth < BITREE_CURSOR_DEPTH) {
+            cursor->stack[depth] = current;
+        }
+        int cmp = node_cmp(current, prefix, key);
+        bool take;
+        bool go_left;
+        switch (mode) {
+        case SEEK_GE: take = cmp <= 0; go_left = take; break;
+        case SEEK_GT: take = cmp < 0;  go_left = take; break;
+        case SEEK_LE: take = cmp >= 0; go_left = !take; break;
+        default:      take = cmp > 0;  go_left = !take; break;
+        }
+        if (take) {
+            match = current;
+            match_depth = depth;
+            if (cmp == 0) {
+                break; // Exact hit on an inclusive bound
+            }
+        }
+        current = go_left ? current->left : current->right;
+    }
+
+    cursor->node = match;
+    cursor->depth = match_depth <= BITREE_CURSOR_DEPTH ? match_depth : -1;
+    return match;
+}
+
+// Walk from the cursor node (or the root) to the leftmost/rightmost node
+static BiTreeNode* cursor_edge(BiTreeCursor *cursor, BiTreeNode *from, bool leftmost) {
+    BiTreeNode *current = from;
+    while (current != NULL) {
+        BiTreeNode *child = leftmost ? current->left : current->right;
+        if (child == NULL) {
+            break;
+        }
+        if (cursor->depth >= 0 && cursor->depth < BITREE_CURSOR_DEPTH) {
+            cursor->stack[cursor->depth++] = current;
+        } else {
+            cursor->depth = -1;
+        }
+        current = child;
+    }
+    cursor->node = current;
+    return current;
+}
+
+// Step to the inorder neighbour on one side of the cursor node
+static BiTreeNode* cursor_step(BiTreeCursor *cursor, bool forward) {
+    BiTreeNode *node = cursor->node;
+    if (node == NULL) {
+        return NULL;
+    }
+
+    // The path did not fit: find the neighbour by key from the root
+    if (cursor->depth < 0) {
+        return cursor_descend(cursor, node->data, forward ? SEEK_GT : SEEK_LT);
+    }
+
+    BiTreeNode *child = forward ? node->right : node->left;
+    if (child != NULL) {
+        if (cursor->depth == BITREE_CURSOR_DEPTH) {
+            return cursor_descend(cursor, node->data, forward ? SEEK_GT : SEEK_LT);
+        }
+        cursor->stack[cursor->depth++] = node;
+        return cursor_edge(cursor, child, forward);
+    }
+
+    // Climb until we leave a subtree on the side we are moving away from
+    while (cursor->depth > 0) {
+        BiTreeNode *parent = cursor->stack[--cursor->depth];
+        if ((forward ? parent->left : parent->right) == node) {
+            cursor->node = parent;
+            return parent;
+        }
+        node = parent;
+    }
+    cursor->node = NULL;
+    return NULL;
+}
+
+// Function to bind a cursor to a tree; it starts before the first key
+void BiTree_cursorInit(BiTreeCursor *cursor, BiTreeNode *root) {
+    cursor->root = root;
+    cursor->node = NULL;
+    cursor->depth = 0;
+}
+
+BiTreeNode* BiTree_cursorFirst(BiTreeCursor *cursor) {
+    cursor->depth = 0;
+    return cursor_edge(cursor, cursor->root, true);
+}
+
+BiTreeNode* BiTree_cursorLast(BiTreeCursor *cursor) {
+    cursor->depth = 0;
+    return cursor_edge(cursor, cursor->root, false);
+}
+
+// Position the cursor on the first key >= key
+BiTreeNode* BiTree_cursorSeek(BiTreeCursor *cursor, const char *key) {
+    return cursor_descend(cursor, key, SEEK_GE);
+}
+
+BiTreeNode* BiTree_cursorNext(BiTreeCursor *cursor) {
+    return cursor_step(cursor, true);
+}
+
+BiTreeNode* BiTree_cursorPrev(BiTreeCursor *cursor) {
+    return cursor_step(cursor, false);
+}
+
+// Function to visit every key in [lo, hi] in order. A NULL bound is open.
+// Returns the number of nodes visited.
+size_t BiTree_range(BiTreeNode *root, const char *lo, const char *hi, BiTree_visit visit, void *ctx) {
+    BiTreeCursor cursor;
+    BiTree_cursorInit(&cursor, root);
+    BiTreeNode *node = lo != NULL ? BiTree_cursorSeek(&cursor, lo) : BiTree_cursorFirst(&cursor);
+
+    uint64_t hi_prefix = hi != NULL ? key_prefix(hi) : 0;
+    size_t visited = 0;
+    for (; node != NULL; node = BiTree_cursorNext(&cursor)) {
+        if (hi != NULL && node_cmp(node, hi_prefix, hi) < 0) {
+            break;
+        }
+        visited++;
+        if (!visit(node, ctx)) {
+            break;
+        }
+    }
+    return visited;
+}
+
+// Function to visit every key starting with prefix, in order
+size_t BiTree_prefixScan(BiTreeNode *root, const char *prefix, BiTree_visit visit, void *ctx) {
+    size_t length = strlen(prefix);
+    BiTreeCursor cursor;
+    BiTree_cursorInit(&cursor, root);
+
+    size_t visited = 0;
+    for (BiTreeNode *node = BiTree_cursorSeek(&cursor, prefix); node != NULL; node = BiTree_cursorNext(&cursor)) {
+        if (strncmp(node->data, prefix, length) != 0) {
+            break;
+        }
+        visited++;
+        if (!visit(node, ctx)) {
+            break;
+        }
+    }
+    return visited;
+}
+
+// Function to calculate the depth of a binary tree. The walk keeps the
+// current path on an explicit stack, so trees of any shape are measured
+// without deep recursion.
 int BiTree_depth(BiTreeNode* root) {
     // Base case: if the root is NULL, the depth is 0
     if (root == NULL) {
         return 0;
-    } else {
-        // Calculate the depth of the left and right subtrees recursively
-        int left_depth = BiTree_depth(root->left);
-        int right_depth = BiTree_depth(root->right);
+    }
 
-        // Return the maximum depth among the left and right subtrees, plus 1 for the root
-        return 1 + (left_depth > right_depth ? left_depth : right_depth);
+    int capacity = 0;
+    BiTreeNode **path = reserve_nodes(NULL, 0, &capacity, "depth path");
+    int top = 0;
+    int depth = 1;
+    BiTreeNode *previous = NULL;
+    path[top++] = root;
+    while (top > 0) {
+        BiTreeNode *current = path[top - 1];
+        BiTreeNode *next = NULL;
+        if (previous == NULL || previous->left == current || previous->right == current) {
+            // Coming down: descend into the first child
+            next = current->left != NULL ? current->left : current->right;
+        } else if (previous == current->left) {
+            // Back up from the left subtree: the right one is next
+            next = current->right;
+        }
+        if (next != NULL) {
+            path = reserve_nodes(path, top, &capacity, "depth path");
+            path[top++] = next;
+            depth = top > depth ? top : depth;
+        } else {
+            top--; // Both subtrees done
+        }
+        previous = current;
     }
+    free(path);
+    return depth;
 }
 
-// Function to perform depth-first search (DFS) traversal and serialize the tree
+// Function to perform depth-first search (DFS) traversal and serialize the tree.
+// Pending subtrees go on an explicit stack, so deep trees do not recurse.
 void BiTree_serialize(FILE *fp, BiTreeNode* root, const char* algo) {
     if (root == NULL) {
         fprintf(fp, "#\n"); // Represent NULL node and move to the next line
@@ -348,9 +1694,25 @@ void BiTree_serialize(FILE *fp, BiTreeNode* root, const char* algo) {
         // Perform breadth-first serialization (not implemented here)
     } else if (strcmp(algo, "dfs") == 0) {
         // Perform depth-first serialization
-        fprintf(fp, "%d %s\n", root->key, root->data); // Serialize node data and move to the next line
-        BiTree_serialize(fp, root->left, algo); // Serialize left subtree
-        BiTree_serialize(fp, root->right, algo); // Serialize right subtree
+        int capacity = 0;
+        BiTreeNode **stack = reserve_nodes(NULL, 0, &capacity, "serialize stack");
+        int top = 0;
+        stack[top++] = root;
+        while (top > 0) {
+            BiTreeNode *node = stack[--top];
+            if (node == NULL) {
+                fprintf(fp, "#\n");
+                continue;
+            }
+            // Each record is "<value> <length> <key>": the length lets the
+            // reader take keys of any size, spaces included
+            fprintf(fp, "%lld %zu %s\n", (long long)node->value.i64, strlen(node->data), node->data);
+            // Right goes first so the left subtree is written before it
+            stack = reserve_nodes(stack, top + 1, &capacity, "serialize stack");
+            stack[top++] = node->right;
+            stack[top++] = node->left;
+        }
+        free(stack);
     } else {
         fprintf(stderr, "Unsupported serialization algorithm: %s\n", algo);
     }
@@ -370,43 +1732,101 @@ bool BiTree_isfull(BiTreeNode *root) {
         return true;
     }
 
-    // If both children are present, recursively check if their subtrees are full
-    if (root->left != NULL && root->right != NULL) {
-        return BiTree_isfull(root->left) && BiTree_isfull(root->right);
+    // Check every node with an explicit stack, so deep trees do not recurse
+    int capacity = 0;
+    BiTreeNode **stack = reserve_nodes(NULL, 0, &capacity, "stack");
+    int top = 0;
+    bool full = true;
+    stack[top++] = root;
+    while (top > 0) {
+        BiTreeNode *node = stack[--top];
+        if (node->left == NULL && node->right == NULL) {
+            continue; // A leaf is full
+        }
+        if (node->left == NULL || node->right == NULL) {
+            full = false; // If only one child is present, the tree is not full
+            break;
+        }
+        stack = reserve_nodes(stack, top + 1, &capacity, "stack");
+        stack[top++] = node->right;
+        stack[top++] = node->left;
     }
-
-    // If only one child is present, the tree is not full
-    return false;
+    free(stack);
+    return full;
 }
 // Function to destroy a binary tree, including its nodes and associated data
 void BiTree_destroy(BiTree* tree) {
-    if (tree == NULL || tree->root == NULL) {
-        return;  // Base case: If the tree or its root is NULL, there's nothing to destroy
+    if (tree == NULL) {
+        return;  // Base case: If the tree is NULL, there's nothing to destroy
     }
 
-    BiTree_free(tree->root); // Free memory associated with the nodes and their data
+    if (tree->arena != NULL) {
+        // Every node and long key lives in the arena: drop the blocks wholesale
+        arena_destroy(tree->arena);
+    } else {
+        BiTree_free(tree->root); // Free memory associated with the nodes and their data
+    }
+    bitree_index_destroy(tree->index);
+    free(tree->stats);
     free(tree); // Free memory associated with the tree structure itself
 }
 
-// Function to free memory associated with the nodes of a binary tree
-void BiTree_free(BiTreeNode *root) {
-    if (root == NULL) {
-        return; // Base case: If the root is NULL, there's nothing to free
+// Function to read the statistics of a tree. Size, memory and height are
+// always filled in; returns true if the per-operation counters are live
+// too, i.e. the library was built with BITREE_STATS.
+bool BiTree_stats(const BiTree *tree, BiTreeStats *stats) {
+    if (tree != NULL && tree->stats != NULL) {
+        *stats = *tree->stats;
+    } else {
+        memset(stats, 0, sizeof(BiTreeStats));
     }
+    if (tree == NULL) {
+        return false;
+    }
+    stats->node_count = tree->node_count;
+    // Splaying does not keep the AVL heights, so measure the tree instead
+    stats->height = tree->splay ? BiTree_depth(tree->root) : subtree_depth(tree->root);
+    if (tree->arena != NULL) {
+        stats->bytes = tree->arena->bytes + tree->arena->map_size;
+        stats->blocks = tree->arena->blocks;
+    }
+    if (tree->index != NULL) {
+        stats->bytes += bitree_index_bytes(tree->index);
+    }
+    return tree->stats != NULL;
+}
 
-    // Free memory associated with left and right subtrees recursively
-    BiTree_free(root->left);
-    BiTree_free(root->right);
+// Function to zero the per-operation counters of a tree
+void BiTree_statsReset(BiTree *tree) {
+    if (tree != NULL && tree->stats != NULL) {
+        memset(tree->stats, 0, sizeof(BiTreeStats));
+    }
+}
 
-    // Free memory associated with the current node's data
-    free(root->data);
+// Function to free memory associated with the nodes of a binary tree.
+// Left children are rotated onto the right spine so the walk needs no
+// recursion or auxiliary stack, whatever the shape of the tree.
+void BiTree_free(BiTreeNode *root) {
+    while (root != NULL) {
+        if (root->left != NULL) {
+            BiTreeNode *left = root->left;
+            root->left = left->right;
+            left->right = root;
+            root = left;
+            continue;
+        }
+
+        BiTreeNode *next = root->right;
 
-    // Free memory associated with the current node
-    free(root);
+        // Free the node and its key; arena nodes go back with their arena
+        node_release(NULL, root);
+        root = next;
+    }
 }
 
 
-// Function to check if a binary tree is complete
+// Function to check if a binary tree is complete: every level is full
+// except possibly the last, whose nodes are packed to the left
 bool BiTree_iscomplete(BiTreeNode *root) {
     // Base case: If the tree is empty (root is NULL), it is complete
     if (root == NULL) {
@@ -414,79 +1834,1240 @@ bool BiTree_iscomplete(BiTreeNode *root) {
     }
 
     // Create a queue to perform level-order traversal
-    BiTreeNode **queue = (BiTreeNode **)malloc(sizeof(BiTreeNode *));
+    int capacity = 0;
+    BiTreeNode **queue = reserve_nodes(NULL, 0, &capacity, "queue");
     int front = 0; // Front of the queue
     int rear = -1; // Rear of the queue
 
     // Enqueue the root node
     queue[++rear] = root;
 
-    // Flag to track whether we've encountered a non-full node
-    bool non_full_node_encountered = false;
+    // Set once a missing child has been seen in level order
+    bool gap_seen = false;
+    bool complete = true;
 
     // Perform level-order traversal
-    while (front <= rear) {
+    while (complete && front <= rear) {
         // Dequeue a node from the front of the queue
         BiTreeNode *current = queue[front++];
+        BiTreeNode *children[2] = { current->left, current->right };
+
+        for (int i = 0; i < 2; i++) {
+            if (children[i] == NULL) {
+                gap_seen = true;
+            } else if (gap_seen) {
+                // A node after a gap: the last level is not packed left
+                complete = false;
+                break;
+            } else {
+                queue = reserve_nodes(queue, rear + 1, &capacity, "queue");
+                queue[++rear] = children[i];
+            }
+        }
+    }
 
-        // If we've encountered a non-full node previously and the current node is not a leaf,
-        // the tree is not complete
-        if (non_full_node_encountered && (current->left != NULL || current->right != NULL)) {
-            free(queue); // Free the memory allocated for the queue
+    // Free the memory allocated for the queue
+    free(queue);
+    return complete;
+}
+
+
+// Read the "<length> <key>" part of a serialized record into *key, which
+// grows to fit. Returns false on a malformed or truncated record.
+static bool read_record_key(FILE *fp, char **key, size_t *capacity) {
+    size_t length;
+    if (fscanf(fp, "%zu", &length) != 1 || fgetc(fp) != ' ') {
+        return false;
+    }
+    if (length >= *capacity) {
+        char *grown = realloc(*key, length + 1);
+        if (grown == NULL) {
+            fprintf(stderr, "Memory allocation failed for deserialize key.\n");
             return false;
         }
+        *key = grown;
+        *capacity = length + 1;
+    }
+    if (fread(*key, 1, length, fp) != length) {
+        return false;
+    }
+    (*key)[length] = '\0';
+    return true;
+}
 
-        // If the current node has a left child, enqueue it
-        if (current->left != NULL) {
-            queue[++rear] = current->left;
+// Function to deserialize a binary tree
+BiTreeNode* BiTree_deserialize(FILE *fp) {
+    if (fp == NULL) {
+        fprintf(stderr, "File pointer is NULL.\n");
+        return NULL;
+    }
+
+    char value_str[24]; // A value, or "#" for an empty subtree
+    char *data = NULL;  // Key of the current record, grown to the longest one
+    size_t data_capacity = 0;
+
+    // Records come in preorder. Nodes whose right child is still to be read
+    // wait on a stack instead of in recursive calls, so deep trees load too.
+    int capacity = 0;
+    BiTreeNode **waiting = reserve_nodes(NULL, 0, &capacity, "deserialize stack");
+    int top = 0;
+    int order_capacity = 0;
+    BiTreeNode **order = reserve_nodes(NULL, 0, &order_capacity, "deserialize order");
+    int count = 0;
+    BiTreeNode *root = NULL;
+    BiTreeNode *parent = NULL; // Next record is a child of parent, or the root
+    bool left_side = true;
+
+    while (fscanf(fp, "%23s", value_str) == 1) {
+        BiTreeNode *node = NULL;
+        if (strcmp(value_str, "#") != 0) {
+            long long value = strtoll(value_str, NULL, 10);
+            if (read_record_key(fp, &data, &data_capacity)) {
+                node = BiTree_createNode(data);
+            } else {
+                fprintf(stderr, "Malformed record in serialized tree.\n");
+            }
+            if (node == NULL) {
+                BiTree_free(root);
+                root = NULL;
+                count = 0;
+                break;
+            }
+            node->value.i64 = value;
+        }
+
+        if (parent == NULL) {
+            root = node;
+        } else if (left_side) {
+            parent->left = node;
         } else {
-            // If the current node doesn't have a left child, set the flag
-            non_full_node_encountered = true;
+            parent->right = node;
         }
 
-        // If the current node has a right child, enqueue it
-        if (current->right != NULL) {
-            queue[++rear] = current->right;
+        if (node != NULL) {
+            // Its left child comes next, its right child after that subtree
+            waiting = reserve_nodes(waiting, top, &capacity, "deserialize stack");
+            waiting[top++] = node;
+            order = reserve_nodes(order, count, &order_capacity, "deserialize order");
+            order[count++] = node;
+            parent = node;
+            left_side = true;
+        } else if (top > 0) {
+            parent = waiting[--top];
+            left_side = false;
         } else {
-            // If the current node doesn't have a right child, and it's not the last level,
-            // the tree is not complete
-            if (front <= rear) {
-                free(queue); // Free the memory allocated for the queue
-                return false;
-            }
+            break; // NULL node encountered with nothing left to fill
         }
     }
 
-    // Free the memory allocated for the queue
-    free(queue);
+    // Children come after their parent in preorder, so updating in reverse
+    // fills in every subtree before the node above it
+    for (int i = count - 1; i >= 0; i--) {
+        node_update(order[i]);
+    }
+    free(waiting);
+    free(order);
+    free(data);
+    return root;
+}
 
-    // If we reach this point, the tree is complete
+
+// Append key data[0..length) as the next node of a sorted bulk build.
+// Duplicates of the previous key are dropped; a key that sorts before its
+// predecessor fails the build.
+static bool bulk_append(BiTree *tree, BiTreeNode *nodes, size_t *count, const char *data, size_t length) {
+    BiTreeNode *node = &nodes[*count];
+    if (!node_set_key(tree->arena, node, data, length)) {
+        fprintf(stderr, "Failed to copy key for bulk build\n");
+        return false;
+    }
+    if (*count > 0) {
+        int cmp = strcmp(nodes[*count - 1].data, node->data);
+        if (cmp == 0) {
+            return true;
+        }
+        if (cmp > 0) {
+            fprintf(stderr, "Bulk build input is not sorted at \"%s\"\n", node->data);
+            return false;
+        }
+    }
+    node->value.u64 = 0;
+    node->flags = BITREE_NODE_ARENA;
+    (*count)++;
     return true;
 }
 
+// Link the first count bulk-built nodes into the tree
+static BiTree* bulk_finish(BiTree *tree, BiTreeNode *nodes, size_t count) {
+    tree->root = build_balanced(nodes, count);
+    tree->node_count = count;
+    STATS_ADD(tree, node_allocs, count);
+    return tree;
+}
 
-// Function to deserialize a binary tree
-BiTreeNode* BiTree_deserialize(FILE *fp) {
+// Function to build a height-balanced tree from n keys in ascending strcmp
+// order in O(n). All nodes are allocated in one contiguous block. Returns
+// NULL if the keys are out of order.
+BiTree* BiTree_buildSorted(const char **keys, size_t n) {
+    BiTree *tree = BiTree_new(NULL);
+    if (tree == NULL || n == 0) {
+        return tree;
+    }
+    BiTreeNode *nodes = arena_nodes(tree->arena, n);
+    if (nodes == NULL) {
+        BiTree_destroy(tree);
+        return NULL;
+    }
+
+    size_t count = 0;
+    for (size_t i = 0; i < n; i++) {
+        if (!bulk_append(tree, nodes, &count, keys[i], strlen(keys[i]))) {
+            BiTree_destroy(tree);
+            return NULL;
+        }
+    }
+    return bulk_finish(tree, nodes, count);
+}
+
+// Function to bulk build a tree from a file with one key per line, sorted
+// ascending. Empty lines are skipped and a trailing '\r' is dropped.
+BiTree* BiTree_buildSortedFile(const char *path) {
+    size_t size = 0;
+    char *text = map_file(path, &size, true);
+    if (text == NULL) {
+        fprintf(stderr, "Error opening %s for bulk build\n", path);
+        return NULL;
+    }
+    const char *end = text + size;
+
+    // First pass sizes the node block
+    size_t lines = 0;
+    for (const char *p = text; p < end; ) {
+        const char *eol = memchr(p, '\n', end - p);
+        lines++;
+        p = eol != NULL ? eol + 1 : end;
+    }
+
+    BiTree *tree = BiTree_new(NULL);
+    BiTreeNode *nodes = tree != NULL && lines > 0 ? arena_nodes(tree->arena, lines) : NULL;
+    if (tree == NULL || (lines > 0 && nodes == NULL)) {
+        BiTree_destroy(tree);
+        unmap_file(text, size);
+        return NULL;
+    }
+
+    size_t count = 0;
+    for (const char *p = text; p < end; ) {
+        const char *eol = memchr(p, '\n', end - p);
+        const char *next = eol != NULL ? eol + 1 : end;
+        size_t length = (eol != NULL ? eol : end) - p;
+        if (length > 0 && p[length - 1] == '\r') {
+            length--;
+        }
+        if (length > 0 && !bulk_append(tree, nodes, &count, p, length)) {
+            BiTree_destroy(tree);
+            unmap_file(text, size);
+            return NULL;
+        }
+        p = next;
+    }
+    unmap_file(text, size);
+    return bulk_finish(tree, nodes, count);
+}
+
+// Binary snapshot format, version 3. All integers are in host byte order;
+// byte_order lets a reader on a different host reject the file.
+//
+//   header  SnapshotHeader, 40 bytes
+//   table   uint64 chunks, then chunks x SnapshotChunk
+//   records count x { uint32 length; char key[length]; '\0'; uint64 value },
+//           in key order
+//
+// The records are cut into chunks of BITREE_SNAPSHOT_CHUNK keys, each with
+// its own offset and checksum, so chunks can be checked and decoded
+// independently. The header checksum covers the table. Version 2 records
+// have no value, and version 1 files have no table either, with one
+// checksum over all records; both still load, with every value zero.
+//
+// Keys are NUL terminated in the file so a mapped snapshot can hand out
+// pointers straight into the mapping instead of copying every string.
+#define SNAPSHOT_MAGIC "BTSNAP\0\0"
+#define SNAPSHOT_BYTE_ORDER 0x01020304u
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+    uint64_t payload_size;
+    uint64_t checksum;
+} SnapshotHeader;
+
+// Bytes of the value that ends each record of a given format version
+static size_t snapshot_value_bytes(uint32_t version) {
+    return version >= 3 ? sizeof(uint64_t) : 0;
+}
+
+typedef struct {
+    uint64_t offset;            // of the first record, from the start of the file
+    uint64_t size;              // record bytes
+    uint64_t count;             // records
+    uint64_t checksum;          // of the record bytes
+} SnapshotChunk;
+
+// Word-at-a-time running checksum over the record payload
+typedef struct {
+    uint64_t hash;
+    uint64_t length;
+    unsigned char tail[8];
+} Checksum;
+
+static void checksum_mix(Checksum *sum, uint64_t word) {
+    sum->hash = (sum->hash ^ word) * 0x9E3779B97F4A7C15ull;
+    sum->hash ^= sum->hash >> 29;
+}
+
+static void checksum_init(Checksum *sum) {
+    sum->hash = 0xCBF29CE484222325ull;
+    sum->length = 0;
+}
+
+static void checksum_update(Checksum *sum, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    size_t fill = sum->length % 8;
+    sum->length += size;
+
+    // Top up a partial word left over from the previous call
+    if (fill > 0) {
+        size_t take = 8 - fill < size ? 8 - fill : size;
+        memcpy(sum->tail + fill, bytes, take);
+        bytes += take;
+        size -= take;
+        if (fill + take < 8) {
+            return;
+        }
+        uint64_t word;
+        memcpy(&word, sum->tail, 8);
+        checksum_mix(sum, word);
+    }
+    for (; size >= 8; bytes += 8, size -= 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        checksum_mix(sum, word);
+    }
+    memcpy(sum->tail, bytes, size);
+}
+
+static uint64_t checksum_final(Checksum *sum) {
+    size_t fill = sum->length % 8;
+    if (fill > 0) {
+        uint64_t word;
+        memset(sum->tail + fill, 0, 8 - fill);
+        memcpy(&word, sum->tail, 8);
+        checksum_mix(sum, word);
+    }
+    checksum_mix(sum, sum->length);
+    return sum->hash;
+}
+
+// Map a whole file read-only; sequential tells the kernel it will be read
+// front to back. Hosts without mmap read it into memory.
+static void* map_file(const char *path, size_t *size, bool sequential) {
+#ifdef _WIN32
+    (void)sequential;
+    FILE *fp = fopen(path, "rb");
     if (fp == NULL) {
-        fprintf(stderr, "File pointer is NULL.\n");
         return NULL;
     }
+    void *data = NULL;
+    if (fseek(fp, 0, SEEK_END) == 0) {
+        long length = ftell(fp);
+        rewind(fp);
+        data = length > 0 ? malloc(length) : NULL;
+        if (data != NULL && fread(data, 1, length, fp) != (size_t)length) {
+            free(data);
+            data = NULL;
+        }
+        *size = length > 0 ? (size_t)length : 0;
+    }
+    fclose(fp);
+    return data;
+#else
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+    struct stat st;
+    void *data = NULL;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data == MAP_FAILED) {
+            data = NULL;
+        } else {
+            if (sequential) {
+                madvise(data, st.st_size, MADV_SEQUENTIAL);
+            }
+            madvise(data, st.st_size, MADV_WILLNEED);
+            *size = st.st_size;
+        }
+    }
+    close(fd);
+    return data;
+#endif
+}
+
+static void unmap_file(void *map, size_t size) {
+#ifdef _WIN32
+    (void)size;
+    free(map);
+#else
+    munmap(map, size);
+#endif
+}
+
+// path.tmp, where snapshots are written before being renamed over path:
+// the old file stays intact on failure, and a tree loaded from path keeps
+// its mapping
+static char* temp_path(const char *path) {
+    size_t path_length = strlen(path);
+    char *temp = malloc(path_length + 5);
+    if (temp != NULL) {
+        memcpy(temp, path, path_length);
+        memcpy(temp + path_length, ".tmp", 5);
+    }
+    return temp;
+}
+
+// Rename the finished temp file over path, or remove it if writing failed
+static bool replace_file(const char *temp, const char *path, bool ok) {
+#ifdef _WIN32
+    if (ok) {
+        remove(path); // rename does not replace an existing file here
+    }
+#endif
+    ok = ok && rename(temp, path) == 0;
+    if (!ok) {
+        fprintf(stderr, "Error writing snapshot %s\n", path);
+        remove(temp);
+    }
+    return ok;
+}
+
+// Write the tree to path as a binary snapshot. Returns true on success.
+bool BiTree_saveSnapshot(const BiTree *tree, const char *path) {
+    if (tree == NULL || path == NULL) {
+        return false;
+    }
+    char *temp = temp_path(path);
+    if (temp == NULL) {
+        return false;
+    }
+    FILE *fp = fopen(temp, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening %s for snapshot\n", temp);
+        free(temp);
+        return false;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    // Inorder walk with an explicit stack sized from the root height, which
+    // has to be measured in splay mode or past NODE_HEIGHT_MAX; the chunk
+    // table is sized from the subtree count of the root
+    BiTreeNode *root = tree->root;
+    uint64_t count = node_size(root);
+    uint64_t chunks = (count + BITREE_SNAPSHOT_CHUNK - 1) / BITREE_SNAPSHOT_CHUNK;
+    size_t depth = (size_t)(tree->splay ? BiTree_depth(root) : subtree_depth(root)) + 1;
+    BiTreeNode **stack = malloc(depth * sizeof(BiTreeNode *));
+    SnapshotChunk *table = calloc(chunks > 0 ? chunks : 1, sizeof(SnapshotChunk));
+    if (stack == NULL || table == NULL) {
+        free(stack);
+        free(table);
+        fclose(fp);
+        remove(temp);
+        free(temp);
+        return false;
+    }
 
-    char key_str[20];
-    char data_str[100]; // Assuming the maximum length of data string
-    if (fscanf(fp, "%s", key_str) == 1) {
-        if (strcmp(key_str, "#") == 0) {
-            return NULL; // NULL node encountered
+    // The header and table are rewritten once the checksums are known
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(&chunks, sizeof(chunks), 1, fp) == 1
+        && fwrite(table, sizeof(SnapshotChunk), chunks, fp) == chunks;
+    uint64_t offset = sizeof(header) + sizeof(chunks) + chunks * sizeof(SnapshotChunk);
+
+    size_t top = 0;
+    uint64_t written = 0;
+    Checksum sum;
+    BiTreeNode *current = root;
+    while (ok && (current != NULL || top > 0)) {
+        while (current != NULL) {
+            stack[top++] = current;
+            current = current->left;
         }
+        current = stack[--top];
 
-        int key = atoi(key_str);
-        fscanf(fp, "%s", data_str); // Read data
-        BiTreeNode* root = (BiTreeNode*)malloc(sizeof(BiTreeNode));
-        root->key = key;
-        root->data = strdup(data_str); // Duplicate the data string
-        root->left = BiTree_deserialize(fp);
-        root->right = BiTree_deserialize(fp);
-        return root;
+        SnapshotChunk *chunk = &table[written / BITREE_SNAPSHOT_CHUNK];
+        if (written % BITREE_SNAPSHOT_CHUNK == 0) {
+            ok = written < count;
+            if (!ok) {
+                break;
+            }
+            chunk->offset = offset;
+            checksum_init(&sum);
+        }
+        uint32_t length = (uint32_t)strlen(current->data);
+        uint64_t value = current->value.u64;
+        ok = fwrite(&length, sizeof(length), 1, fp) == 1
+            && fwrite(current->data, 1, length + 1, fp) == length + 1
+            && fwrite(&value, sizeof(value), 1, fp) == 1;
+        checksum_update(&sum, &length, sizeof(length));
+        checksum_update(&sum, current->data, length + 1);
+        checksum_update(&sum, &value, sizeof(value));
+        offset += sizeof(length) + length + 1 + sizeof(value);
+        chunk->size += sizeof(length) + length + 1 + sizeof(value);
+        chunk->count++;
+        written++;
+        if (written % BITREE_SNAPSHOT_CHUNK == 0 || written == count) {
+            chunk->checksum = checksum_final(&sum);
+        }
+        current = current->right;
+    }
+    free(stack);
+    if (ok && written != count) {
+        fprintf(stderr, "Snapshot of %s: tree holds %llu keys, not %llu\n",
+                path, (unsigned long long)written, (unsigned long long)count);
+        ok = false;
+    }
+
+    Checksum table_sum;
+    checksum_init(&table_sum);
+    checksum_update(&table_sum, &chunks, sizeof(chunks));
+    checksum_update(&table_sum, table, chunks * sizeof(SnapshotChunk));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = BITREE_SNAPSHOT_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.count = count;
+    header.payload_size = offset - sizeof(header);
+    header.checksum = checksum_final(&table_sum);
+    ok = ok && fseek(fp, 0, SEEK_SET) == 0
+        && fwrite(&header, sizeof(header), 1, fp) == 1
+        && fwrite(&chunks, sizeof(chunks), 1, fp) == 1
+        && fwrite(table, sizeof(SnapshotChunk), chunks, fp) == chunks;
+    free(table);
+    ok = replace_file(temp, path, fclose(fp) == 0 && ok);
+    free(temp);
+    return ok;
+}
+
+// Snapshot being loaded: the mapping, its validated chunk table and the
+// node block the chunks decode into
+struct SnapshotLoad {
+    const char *path;
+    unsigned char *map;
+    size_t size;
+    SnapshotChunk *chunks;
+    uint64_t *firsts;           // node index of the first record of each chunk
+    size_t value_bytes;         // after each key, by format version
+    size_t chunk_count;
+    uint64_t count;
+    BiTree *tree;
+    BiTreeNode *nodes;
+};
+
+// Check the header and chunk table of a snapshot of file_size bytes, the
+// first available of which are at start; NULL if they are valid
+static const char* snapshot_check(const unsigned char *start, size_t available, uint64_t file_size,
+                                  SnapshotHeader *header, uint64_t *chunk_count) {
+    if (available < sizeof(*header)) {
+        return "truncated header";
+    }
+    memcpy(header, start, sizeof(*header));
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(header->magic)) != 0) {
+        return "bad magic";
+    }
+    if (header->version < 1 || header->version > BITREE_SNAPSHOT_VERSION) {
+        return "unsupported version";
+    }
+    if (header->byte_order != SNAPSHOT_BYTE_ORDER) {
+        return "written on a host with different byte order";
+    }
+    if (header->payload_size != file_size - sizeof(*header)) {
+        return "size mismatch";
+    }
+    if (header->version == 1) {
+        *chunk_count = header->count > 0 ? 1 : 0;
+        return NULL;
+    }
+    if (available - sizeof(*header) < sizeof(uint64_t)) {
+        return "truncated chunk table";
+    }
+    memcpy(chunk_count, start + sizeof(*header), sizeof(*chunk_count));
+    if (*chunk_count > (available - sizeof(*header) - sizeof(uint64_t)) / sizeof(SnapshotChunk)) {
+        return "truncated chunk table";
+    }
+    Checksum sum;
+    checksum_init(&sum);
+    checksum_update(&sum, start + sizeof(*header), sizeof(uint64_t) + *chunk_count * sizeof(SnapshotChunk));
+    if (checksum_final(&sum) != header->checksum) {
+        return "chunk table checksum mismatch";
+    }
+    return NULL;
+}
+
+// Bytes of the header and chunk table of a snapshot
+static uint64_t snapshot_table_bytes(const SnapshotHeader *header, uint64_t chunk_count) {
+    return sizeof(*header) + (header->version == 1 ? 0 : sizeof(uint64_t) + chunk_count * sizeof(SnapshotChunk));
+}
+
+// Entry i of a validated chunk table; version 1 files have one chunk
+// spanning all records under the header checksum
+static SnapshotChunk snapshot_chunk(const unsigned char *start, const SnapshotHeader *header, size_t i) {
+    if (header->version == 1) {
+        return (SnapshotChunk){ sizeof(*header), header->payload_size, header->count, header->checksum };
+    }
+    SnapshotChunk chunk;
+    memcpy(&chunk, start + sizeof(*header) + sizeof(uint64_t) + i * sizeof(SnapshotChunk), sizeof(chunk));
+    return chunk;
+}
+
+// Map a snapshot and validate everything but the chunk contents, which
+// bitree_snapshot_decode checks one chunk at a time, and allocate the node
+// block for every key. Returns NULL on failure.
+SnapshotLoad* bitree_snapshot_open(const char *path) {
+    size_t size = 0;
+    unsigned char *map = map_file(path, &size, true);
+    if (map == NULL) {
+        fprintf(stderr, "Error opening snapshot %s\n", path);
+        return NULL;
+    }
+
+    SnapshotHeader header;
+    uint64_t chunk_count = 0;
+    const char *error = snapshot_check(map, size, size, &header, &chunk_count);
+    SnapshotLoad *load = error == NULL ? calloc(1, sizeof(SnapshotLoad)) : NULL;
+    if (error == NULL && load == NULL) {
+        error = "out of memory";
+    }
+    if (load != NULL) {
+        load->path = path;
+        load->map = map;
+        load->size = size;
+        load->count = header.count;
+        load->chunk_count = chunk_count;
+        load->value_bytes = snapshot_value_bytes(header.version);
+        load->chunks = malloc((chunk_count > 0 ? chunk_count : 1) * sizeof(SnapshotChunk));
+        load->firsts = malloc((chunk_count > 0 ? chunk_count : 1) * sizeof(uint64_t));
+        if (load->chunks == NULL || load->firsts == NULL) {
+            error = "out of memory";
+        }
+    }
+
+    // Chunks must tile the records exactly, front to back
+    uint64_t offset = snapshot_table_bytes(&header, chunk_count);
+    uint64_t first = 0;
+    for (size_t i = 0; error == NULL && i < chunk_count; i++) {
+        SnapshotChunk *chunk = &load->chunks[i];
+        *chunk = snapshot_chunk(map, &header, i);
+        if (chunk->offset != offset || chunk->size > size - offset) {
+            error = "chunk out of place";
+        } else if (chunk->count > chunk->size / (5 + load->value_bytes) || chunk->count > header.count - first) {
+            // Every record takes at least 5 bytes and its value, bounding a
+            // hostile count
+            error = "chunk record count exceeds its size";
+        } else {
+            load->firsts[i] = first;
+            first += chunk->count;
+            offset += chunk->size;
+        }
+    }
+    if (error == NULL && (offset != size || first != header.count)) {
+        error = "chunks do not cover the records";
+    } else if (error == NULL && header.count > UINT32_MAX) {
+        error = "more keys than a tree holds";
+    }
+
+    if (error == NULL) {
+        load->tree = BiTree_new(NULL);
+        if (load->tree == NULL) {
+            error = "out of memory";
+        } else if (header.count > 0 && (load->nodes = arena_nodes(load->tree->arena, header.count)) == NULL) {
+            error = "out of memory";
+        }
+    }
+    if (error != NULL) {
+        fprintf(stderr, "Invalid snapshot %s: %s\n", path, error);
+        if (load != NULL) {
+            BiTree_destroy(load->tree);
+            free(load->chunks);
+            free(load->firsts);
+            free(load);
+        }
+        unmap_file(map, size);
+        return NULL;
+    }
+    return load;
+}
+
+size_t bitree_snapshot_chunks(const SnapshotLoad *load) {
+    return load->chunk_count;
+}
+
+BiTreeNode* bitree_snapshot_nodes(const SnapshotLoad *load, uint64_t *count) {
+    *count = load->count;
+    return load->nodes;
+}
+
+// Check chunk i and point its nodes at the keys in the mapping, which
+// must strictly ascend. Different chunks may be decoded concurrently.
+bool bitree_snapshot_decode(SnapshotLoad *load, size_t i) {
+    const SnapshotChunk *chunk = &load->chunks[i];
+    const unsigned char *cursor = load->map + chunk->offset;
+    const unsigned char *end = cursor + chunk->size;
+    Checksum sum;
+    checksum_init(&sum);
+    checksum_update(&sum, cursor, chunk->size);
+    const char *error = checksum_final(&sum) != chunk->checksum ? "checksum mismatch" : NULL;
+
+    BiTreeNode *nodes = load->nodes + load->firsts[i];
+    for (uint64_t j = 0; error == NULL && j < chunk->count; j++) {
+        uint32_t length;
+        if ((size_t)(end - cursor) < sizeof(length)) {
+            error = "truncated record";
+            break;
+        }
+        memcpy(&length, cursor, sizeof(length));
+        cursor += sizeof(length);
+        if ((size_t)(end - cursor) <= length || cursor[length] != '\0') {
+            error = "malformed record";
+            break;
+        }
+        if ((size_t)(end - cursor) - length - 1 < load->value_bytes) {
+            error = "truncated record";
+            break;
+        }
+        BiTreeNode *node = &nodes[j];
+        node->data = (char *)cursor;
+        node->prefix = key_prefix(node->data);
+        node->flags = BITREE_NODE_ARENA;
+        cursor += length + 1;
+        node->value.u64 = 0;
+        memcpy(&node->value, cursor, load->value_bytes);
+        cursor += load->value_bytes;
+        // Nodes are linked by position, so a key out of order would make
+        // an invalid search tree
+        if (j > 0 && node_cmp(&nodes[j - 1], node->prefix, node->data) <= 0) {
+            error = "keys out of order";
+        }
+    }
+    if (error == NULL && cursor != end) {
+        error = "trailing bytes";
+    }
+    if (error != NULL) {
+        fprintf(stderr, "Invalid snapshot %s: chunk %zu: %s\n", load->path, i, error);
+        return false;
+    }
+    return true;
+}
+
+// Check that keys ascend across chunk boundaries, once every chunk is
+// decoded; bitree_snapshot_decode checks them within a chunk
+bool bitree_snapshot_ordered(const SnapshotLoad *load) {
+    for (size_t i = 1; i < load->chunk_count; i++) {
+        uint64_t first = load->firsts[i];
+        if (load->chunks[i].count == 0 || first == 0) {
+            continue;
+        }
+        const BiTreeNode *node = &load->nodes[first];
+        if (node_cmp(&load->nodes[first - 1], node->prefix, node->data) <= 0) {
+            fprintf(stderr, "Invalid snapshot %s: chunk %zu: keys out of order\n", load->path, i);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Hand the decoded nodes, linked under root, over to the loaded tree, or
+// with ok unset throw everything away. Frees load either way.
+BiTree* bitree_snapshot_finish(SnapshotLoad *load, BiTreeNode *root, bool ok) {
+    BiTree *tree = load->tree;
+    if (ok) {
+        tree->root = root;
+        tree->node_count = load->count;
+        STATS_ADD(tree, node_allocs, load->count);
+        tree->arena->map = load->map;
+        tree->arena->map_size = load->size;
+    } else {
+        BiTree_destroy(tree);
+        unmap_file(load->map, load->size);
+        tree = NULL;
+    }
+    free(load->chunks);
+    free(load->firsts);
+    free(load);
+    return tree;
+}
+
+// Load a snapshot written by BiTree_saveSnapshot. The file stays mapped for
+// the lifetime of the tree and node keys point into it; nodes are allocated
+// in one contiguous block and linked into a perfectly balanced tree. That
+// block is allocated up front, so loading takes one node per key on top of
+// the mapping; only BiTree_verifySnapshot runs in bounded memory.
+BiTree* BiTree_loadSnapshot(const char *path) {
+    SnapshotLoad *load = bitree_snapshot_open(path);
+    if (load == NULL) {
+        return NULL;
+    }
+    bool ok = true;
+    for (size_t i = 0; ok && i < load->chunk_count; i++) {
+        ok = bitree_snapshot_decode(load, i);
+    }
+    ok = ok && bitree_snapshot_ordered(load);
+    return bitree_snapshot_finish(load, ok ? build_balanced(load->nodes, load->count) : NULL, ok);
+}
+
+// Read a key record of a streamed chunk into *key, growing it as needed,
+// and skip the value_bytes of value after it
+static const char* verify_record(FILE *fp, char **key, size_t *capacity, size_t value_bytes,
+                                 uint64_t *left, Checksum *sum) {
+    uint32_t length;
+    if (*left < sizeof(length) + 1 || fread(&length, sizeof(length), 1, fp) != 1) {
+        return "truncated record";
+    }
+    *left -= sizeof(length);
+    if (*left <= length) {
+        return "malformed record";
+    }
+    if (length + 1 > *capacity) {
+        char *grown = realloc(*key, length + 1);
+        if (grown == NULL) {
+            return "out of memory";
+        }
+        *key = grown;
+        *capacity = length + 1;
+    }
+    if (fread(*key, 1, length + 1, fp) != length + 1u || (*key)[length] != '\0') {
+        return "malformed record";
     }
+    *left -= length + 1;
+    checksum_update(sum, &length, sizeof(length));
+    checksum_update(sum, *key, length + 1);
+    uint64_t value;
+    if (*left < value_bytes || fread(&value, 1, value_bytes, fp) != value_bytes) {
+        return "truncated record";
+    }
+    *left -= value_bytes;
+    checksum_update(sum, &value, value_bytes);
     return NULL;
 }
+
+// Check a snapshot front to back without loading it: header, chunk table,
+// every record and chunk checksum, and that keys strictly ascend. Memory
+// stays bounded by the chunk table and the longest key, so files larger
+// than RAM can be checked.
+bool BiTree_verifySnapshot(const char *path) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening snapshot %s\n", path);
+        return false;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    // Read the header and table, bounded by the file size, and check them
+    // as bitree_snapshot_open does
+    SnapshotHeader header;
+    uint64_t chunk_count = 0;
+    unsigned char *table = NULL;
+    long file_size = -1;
+    const char *error = NULL;
+    if (fseek(fp, 0, SEEK_END) != 0 || (file_size = ftell(fp)) < 0 || fseek(fp, 0, SEEK_SET) != 0) {
+        error = "unreadable file";
+    } else if (fread(&header, sizeof(header), 1, fp) != 1) {
+        error = "truncated header";
+    } else if (header.version != 1 && fread(&chunk_count, sizeof(chunk_count), 1, fp) != 1) {
+        error = "truncated chunk table";
+    } else if (chunk_count > (uint64_t)file_size / sizeof(SnapshotChunk)) {
+        error = "truncated chunk table";
+    } else {
+        size_t table_size = snapshot_table_bytes(&header, chunk_count);
+        table = malloc(table_size);
+        if (table == NULL) {
+            error = "out of memory";
+        } else if (fseek(fp, 0, SEEK_SET) != 0 || fread(table, 1, table_size, fp) != table_size) {
+            error = "truncated chunk table";
+        } else {
+            error = snapshot_check(table, table_size, (uint64_t)file_size, &header, &chunk_count);
+        }
+    }
+
+    char *previous = NULL;
+    char *key = NULL;
+    size_t previous_capacity = 0;
+    size_t key_capacity = 0;
+    uint64_t seen = 0;
+    bool in_chunk = false;
+    size_t i = 0;
+    for (; error == NULL && i < chunk_count; i++) {
+        in_chunk = true;
+        SnapshotChunk chunk = snapshot_chunk(table, &header, i);
+        if ((uint64_t)ftell(fp) != chunk.offset) {
+            error = "chunk out of place";
+            break;
+        }
+        Checksum sum;
+        checksum_init(&sum);
+        uint64_t left = chunk.size;
+        for (uint64_t j = 0; error == NULL && j < chunk.count; j++) {
+            error = verify_record(fp, &key, &key_capacity, snapshot_value_bytes(header.version), &left, &sum);
+            if (error == NULL && seen > 0 && strcmp(previous, key) >= 0) {
+                error = "keys out of order";
+            }
+            // The key just read becomes the previous one
+            char *swap = previous;
+            size_t swap_capacity = previous_capacity;
+            previous = key;
+            previous_capacity = key_capacity;
+            key = swap;
+            key_capacity = swap_capacity;
+            seen++;
+        }
+        if (error == NULL && left != 0) {
+            error = "trailing bytes";
+        } else if (error == NULL && checksum_final(&sum) != chunk.checksum) {
+            error = "checksum mismatch";
+        }
+        if (error != NULL) {
+            break;
+        }
+        in_chunk = false;
+    }
+    if (error == NULL && (seen != header.count || fgetc(fp) != EOF)) {
+        error = "chunks do not cover the records";
+    }
+    if (error != NULL && in_chunk) {
+        fprintf(stderr, "Invalid snapshot %s: chunk %zu: %s\n", path, i, error);
+    } else if (error != NULL) {
+        fprintf(stderr, "Invalid snapshot %s: %s\n", path, error);
+    }
+    free(previous);
+    free(key);
+    free(table);
+    fclose(fp);
+    return error == NULL;
+}
+
+// Frozen tree file format, version 1. The file is the in-memory form, so
+// BiTreeFrozen_open maps it and searches it in place:
+//
+//   header    FrozenHeader, 64 bytes
+//   prefixes  (count + 1) x uint64 key prefix, Eytzinger order from index 1
+//   offsets   (count + 1) x uint64 pool offset of the same keys
+//   pool      pool_size bytes of NUL terminated keys, in key order
+//
+// Index 0 of both arrays is unused so that the children of i are 2i and
+// 2i + 1. With the header one cache line long, the prefixes 3 levels below
+// a slot share one cache line.
+#define FROZEN_MAGIC "BTFROZ\0\0"
+
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+    uint64_t count;
+    uint64_t pool_size;
+    uint64_t checksum;          // of everything after the header
+    unsigned char reserved[24];
+} FrozenHeader;
+
+struct BiTreeFrozen {
+    unsigned char *base;        // FrozenHeader, arrays and pool
+    size_t size;
+    bool mapped;                // base came from map_file
+    uint64_t count;
+    uint64_t pool_size;
+    const uint64_t *prefixes;
+    const uint64_t *offsets;
+    const char *pool;
+};
+
+// Bytes of a frozen tree with count keys and pool_size bytes of keys
+static size_t frozen_bytes(uint64_t count, uint64_t pool_size) {
+    return sizeof(FrozenHeader) + 2 * (count + 1) * sizeof(uint64_t) + pool_size;
+}
+
+// Wrap a buffer holding a validated frozen tree
+static BiTreeFrozen* frozen_attach(unsigned char *base, size_t size, bool mapped) {
+    BiTreeFrozen *frozen = malloc(sizeof(BiTreeFrozen));
+    if (frozen == NULL) {
+        fprintf(stderr, "Memory allocation failed for frozen tree.\n");
+        return NULL;
+    }
+    FrozenHeader header;
+    memcpy(&header, base, sizeof(header));
+    frozen->base = base;
+    frozen->size = size;
+    frozen->mapped = mapped;
+    frozen->count = header.count;
+    frozen->pool_size = header.pool_size;
+    frozen->prefixes = (const uint64_t *)(base + sizeof(header));
+    frozen->offsets = frozen->prefixes + header.count + 1;
+    frozen->pool = (const char *)(frozen->offsets + header.count + 1);
+    return frozen;
+}
+
+typedef struct {
+    TreeWalk walk;
+    BiTreeNode *node;           // next key in order
+    uint64_t count;
+    uint64_t *prefixes;
+    uint64_t *offsets;
+    char *pool;
+    uint64_t used;
+} FreezeFill;
+
+// Inorder walk of the implicit tree rooted at slot k, handing out the keys
+// of the source tree in order: the result is the Eytzinger layout
+static void freeze_fill(FreezeFill *fill, uint64_t k) {
+    if (k > fill->count) {
+        return;
+    }
+    freeze_fill(fill, 2 * k);
+    BiTreeNode *node = fill->node;
+    size_t length = strlen(node->data);
+    memcpy(fill->pool + fill->used, node->data, length + 1);
+    fill->prefixes[k] = node->prefix;
+    fill->offsets[k] = fill->used;
+    fill->used += length + 1;
+    fill->node = walk_next(&fill->walk);
+    freeze_fill(fill, 2 * k + 1);
+}
+
+// Copy the tree into a read-only frozen form laid out for cache friendly
+// search. The tree is not modified and stays usable.
+BiTreeFrozen* BiTree_freeze(const BiTree *tree) {
+    if (tree == NULL) {
+        return NULL;
+    }
+    // First pass sizes the pool
+    FreezeFill fill;
+    fill.count = 0;
+    uint64_t pool_size = 0;
+    for (BiTreeNode *node = walk_first(&fill.walk, tree->root); node != NULL; node = walk_next(&fill.walk)) {
+        pool_size += strlen(node->data) + 1;
+        fill.count++;
+    }
+    free(fill.walk.stack);
+
+    size_t size = frozen_bytes(fill.count, pool_size);
+#ifdef _WIN32
+    unsigned char *base = malloc(size);
+#else
+    // Cache line aligned like a mapping, so prefetches cover whole lines
+    unsigned char *base = aligned_alloc(64, (size + 63) & ~(size_t)63);
+#endif
+    if (base == NULL) {
+        fprintf(stderr, "Memory allocation failed for frozen tree.\n");
+        return NULL;
+    }
+    fill.prefixes = (uint64_t *)(base + sizeof(FrozenHeader));
+    fill.offsets = fill.prefixes + fill.count + 1;
+    fill.pool = (char *)(fill.offsets + fill.count + 1);
+    fill.prefixes[0] = 0;
+    fill.offsets[0] = 0;
+    fill.used = 0;
+    fill.node = walk_first(&fill.walk, tree->root);
+    freeze_fill(&fill, 1);
+    free(fill.walk.stack);
+
+    FrozenHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FROZEN_MAGIC, sizeof(header.magic));
+    header.version = BITREE_FROZEN_VERSION;
+    header.byte_order = SNAPSHOT_BYTE_ORDER;
+    header.count = fill.count;
+    header.pool_size = pool_size;
+    Checksum sum;
+    checksum_init(&sum);
+    checksum_update(&sum, base + sizeof(header), size - sizeof(header));
+    header.checksum = checksum_final(&sum);
+    memcpy(base, &header, sizeof(header));
+
+    BiTreeFrozen *frozen = frozen_attach(base, size, false);
+    if (frozen == NULL) {
+        free(base);
+    }
+    return frozen;
+}
+
+// Slot of the first key >= key, or 0 if every key is smaller. The descent
+// has no data dependent branch: each level turns right by adding the
+// comparison result to 2i, and the cache line holding the slots 3 levels
+// down is prefetched while this level is compared. Only keys that share
+// all 8 prefix bytes with a slot fall back to strcmp.
+static uint64_t frozen_lower_bound(const BiTreeFrozen *frozen, const char *key) {
+    const uint64_t *prefixes = frozen->prefixes;
+    uint64_t count = frozen->count;
+    uint64_t prefix = key_prefix(key);
+    uint64_t i = 1;
+    while (i <= count) {
+        __builtin_prefetch(prefixes + 8 * i);
+        uint64_t slot = prefixes[i];
+        uint64_t right = slot < prefix;
+        if (slot == prefix && (prefix & 0xff) != 0) {
+            right = strcmp(frozen->pool + frozen->offsets[i] + 8, key + 8) < 0;
+        }
+        i = 2 * i + right;
+    }
+    // i spells the path taken; the answer is where it last turned left
+    return i >> __builtin_ffsll((long long)~i);
+}
+
+// Stored copy of key, or NULL if the frozen tree does not hold it
+const char* BiTreeFrozen_find(const BiTreeFrozen *frozen, const char *key) {
+    if (frozen == NULL || key == NULL) {
+        return NULL;
+    }
+    uint64_t i = frozen_lower_bound(frozen, key);
+    if (i == 0) {
+        return NULL;
+    }
+    uint64_t prefix = key_prefix(key);
+    const char *found = frozen->pool + frozen->offsets[i];
+    if (frozen->prefixes[i] != prefix) {
+        return NULL;
+    }
+    if ((prefix & 0xff) != 0 && strcmp(found + 8, key + 8) != 0) {
+        return NULL;
+    }
+    return found;
+}
+
+// Smallest stored key >= key, or NULL if there is none
+const char* BiTreeFrozen_seek(const BiTreeFrozen *frozen, const char *key) {
+    if (frozen == NULL || key == NULL) {
+        return NULL;
+    }
+    uint64_t i = frozen_lower_bound(frozen, key);
+    return i == 0 ? NULL : frozen->pool + frozen->offsets[i];
+}
+
+// Visit keys in [lo, hi] in order; a NULL bound is open, as in BiTree_range.
+// The pool holds the keys sorted, so after one search the scan is a
+// sequential walk. Returns the number visited.
+size_t BiTreeFrozen_range(const BiTreeFrozen *frozen, const char *lo, const char *hi, BiTreeFrozen_visit visit, void *ctx) {
+    if (frozen == NULL || frozen->count == 0) {
+        return 0;
+    }
+    const char *key = lo != NULL ? BiTreeFrozen_seek(frozen, lo) : frozen->pool;
+    if (key == NULL) {
+        return 0;
+    }
+    const char *end = frozen->pool + frozen->pool_size;
+    size_t visited = 0;
+    while (key < end && (hi == NULL || strcmp(key, hi) <= 0)) {
+        visited++;
+        if (!visit(key, ctx)) {
+            break;
+        }
+        key += strlen(key) + 1;
+    }
+    return visited;
+}
+
+size_t BiTreeFrozen_size(const BiTreeFrozen *frozen) {
+    return frozen == NULL ? 0 : frozen->count;
+}
+
+// Write the frozen tree to path. Returns true on success.
+bool BiTreeFrozen_save(const BiTreeFrozen *frozen, const char *path) {
+    if (frozen == NULL || path == NULL) {
+        return false;
+    }
+    char *temp = temp_path(path);
+    if (temp == NULL) {
+        return false;
+    }
+    FILE *fp = fopen(temp, "wb");
+    if (fp == NULL) {
+        fprintf(stderr, "Error opening %s for snapshot\n", temp);
+        free(temp);
+        return false;
+    }
+    bool ok = fwrite(frozen->base, 1, frozen->size, fp) == frozen->size;
+    ok = replace_file(temp, path, fclose(fp) == 0 && ok);
+    free(temp);
+    return ok;
+}
+
+// Map a file written by BiTreeFrozen_save and search it in place; pages are
+// read on demand. The header is always checked. With verify set the
+// checksum and every key offset are checked too, which reads the whole
+// file; without it the file must be trusted.
+BiTreeFrozen* BiTreeFrozen_open(const char *path, bool verify) {
+    size_t size = 0;
+    unsigned char *map = map_file(path, &size, false);
+    if (map == NULL) {
+        fprintf(stderr, "Error opening snapshot %s\n", path);
+        return NULL;
+    }
+
+    FrozenHeader header;
+    const char *error = NULL;
+    if (size < frozen_bytes(0, 0)) {
+        error = "truncated header";
+    } else {
+        memcpy(&header, map, sizeof(header));
+        // Bound count before frozen_bytes can overflow on it
+        uint64_t slots = (size - sizeof(header)) / (2 * sizeof(uint64_t));
+        if (memcmp(header.magic, FROZEN_MAGIC, sizeof(header.magic)) != 0) {
+            error = "bad magic";
+        } else if (header.version != BITREE_FROZEN_VERSION) {
+            error = "unsupported version";
+        } else if (header.byte_order != SNAPSHOT_BYTE_ORDER) {
+            error = "written on a host with different byte order";
+        } else if (header.count >= slots || header.pool_size > size
+                   || frozen_bytes(header.count, header.pool_size) != size) {
+            error = "size mismatch";
+        } else if (header.count > header.pool_size
+                   || (header.pool_size > 0 && map[size - 1] != '\0')) {
+            error = "malformed key pool";
+        }
+    }
+    if (error == NULL && verify) {
+        Checksum sum;
+        checksum_init(&sum);
+        checksum_update(&sum, map + sizeof(header), size - sizeof(header));
+        if (checksum_final(&sum) != header.checksum) {
+            error = "checksum mismatch";
+        }
+        const uint64_t *offsets = (const uint64_t *)(map + sizeof(header)) + header.count + 1;
+        for (uint64_t i = 1; error == NULL && i <= header.count; i++) {
+            if (offsets[i] >= header.pool_size) {
+                error = "key offset out of range";
+            }
+        }
+    }
+    if (error != NULL) {
+        fprintf(stderr, "Invalid snapshot %s: %s\n", path, error);
+        unmap_file(map, size);
+        return NULL;
+    }
+
+    BiTreeFrozen *frozen = frozen_attach(map, size, true);
+    if (frozen == NULL) {
+        unmap_file(map, size);
+    }
+    return frozen;
+}
+
+void BiTreeFrozen_destroy(BiTreeFrozen *frozen) {
+    if (frozen == NULL) {
+        return;
+    }
+    if (frozen->mapped) {
+        unmap_file(frozen->base, frozen->size);
+    } else {
+        free(frozen->base);
+    }
+    free(frozen);
+}
@@ -0,0 +1,179 @@
+#include "bitree.h"
+#include "bitree_internal.h"
+
+// Exact-match hash index over the nodes of a BiTree, enabled with
+// BiTree_enableIndex. Open addressing with Robin Hood probing: an entry
+// that is further from its home slot than the one it meets takes that
+// slot, which keeps every probe sequence short and lets a miss stop as
+// soon as it passes entries closer to home than itself. Entries keep the
+// full hash, so growing never rehashes a key and most mismatches are
+// rejected without touching the node.
+
+// Smallest table, and the fill limit as a fraction of the capacity
+#define INDEX_MIN_SLOTS 16
+#define INDEX_LOAD_NUM 7
+#define INDEX_LOAD_DEN 8
+
+typedef struct {
+    uint64_t hash;
+    BiTreeNode *node;           // NULL for an empty slot
+} IndexSlot;
+
+struct BiTreeIndex {
+    IndexSlot *slots;
+    size_t mask;                // capacity - 1, capacity a power of two
+    size_t count;
+};
+
+static uint64_t hash_mix(uint64_t hash) {
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdull;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ull;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Hash of key where prefix is key_prefix(key). The prefix already packs
+// the first 8 bytes, so only longer keys read the key bytes, a word at a
+// time.
+static uint64_t key_hash(uint64_t prefix, const char *key) {
+    uint64_t hash = prefix * 0x9E3779B97F4A7C15ull;
+    if ((prefix & 0xff) != 0) {
+        const char *rest = key + 8;
+        size_t length = strlen(rest);
+        for (; length >= 8; rest += 8, length -= 8) {
+            uint64_t word;
+            memcpy(&word, rest, 8);
+            hash = (hash ^ word) * 0x9E3779B97F4A7C15ull;
+            hash ^= hash >> 29;
+        }
+        uint64_t word = 0;
+        memcpy(&word, rest, length);
+        hash = (hash ^ word ^ ((uint64_t)length << 56)) * 0x9E3779B97F4A7C15ull;
+    }
+    return hash_mix(hash);
+}
+
+// Distance of the entry in slot i from its home slot
+static size_t slot_distance(const BiTreeIndex *index, size_t i) {
+    return (i - (index->slots[i].hash & index->mask)) & index->mask;
+}
+
+// Place an entry whose key is not in the table yet
+static void index_place(BiTreeIndex *index, IndexSlot entry) {
+    size_t i = entry.hash & index->mask;
+    size_t distance = 0;
+    while (index->slots[i].node != NULL) {
+        size_t other = slot_distance(index, i);
+        if (other < distance) {
+            IndexSlot displaced = index->slots[i];
+            index->slots[i] = entry;
+            entry = displaced;
+            distance = other;
+        }
+        i = (i + 1) & index->mask;
+        distance++;
+    }
+    index->slots[i] = entry;
+}
+
+// Move every entry into a table of capacity slots
+static bool index_resize(BiTreeIndex *index, size_t capacity) {
+    IndexSlot *slots = calloc(capacity, sizeof(IndexSlot));
+    if (slots == NULL) {
+        return false;
+    }
+    IndexSlot *old = index->slots;
+    size_t old_capacity = old != NULL ? index->mask + 1 : 0;
+    index->slots = slots;
+    index->mask = capacity - 1;
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old[i].node != NULL) {
+            index_place(index, old[i]);
+        }
+    }
+    free(old);
+    return true;
+}
+
+// Create an index with room for expected keys before it has to grow
+BiTreeIndex* bitree_index_new(size_t expected) {
+    BiTreeIndex *index = calloc(1, sizeof(BiTreeIndex));
+    if (index == NULL) {
+        return NULL;
+    }
+    size_t capacity = INDEX_MIN_SLOTS;
+    while (capacity / INDEX_LOAD_DEN * INDEX_LOAD_NUM < expected) {
+        capacity *= 2;
+    }
+    if (!index_resize(index, capacity)) {
+        free(index);
+        return NULL;
+    }
+    return index;
+}
+
+// Add a node whose key is not indexed yet. Returns false if the table had
+// to grow and could not.
+bool bitree_index_put(BiTreeIndex *index, BiTreeNode *node) {
+    size_t capacity = index->mask + 1;
+    if ((index->count + 1) * INDEX_LOAD_DEN > capacity * INDEX_LOAD_NUM
+        && !index_resize(index, capacity * 2)) {
+        return false;
+    }
+    index_place(index, (IndexSlot){ key_hash(node->prefix, node->data), node });
+    index->count++;
+    return true;
+}
+
+// Drop a node from the index. Later entries of the probe run shift back
+// one slot, so no tombstones are left behind.
+void bitree_index_remove(BiTreeIndex *index, const BiTreeNode *node) {
+    size_t i = key_hash(node->prefix, node->data) & index->mask;
+    while (index->slots[i].node != node) {
+        if (index->slots[i].node == NULL) {
+            return;
+        }
+        i = (i + 1) & index->mask;
+    }
+    size_t next = (i + 1) & index->mask;
+    while (index->slots[next].node != NULL && slot_distance(index, next) > 0) {
+        index->slots[i] = index->slots[next];
+        i = next;
+        next = (next + 1) & index->mask;
+    }
+    index->slots[i].node = NULL;
+    index->count--;
+}
+
+// Node holding key, where prefix is key_prefix(key), or NULL. *probes
+// receives the number of slots read.
+BiTreeNode* bitree_index_get(const BiTreeIndex *index, const char *key, uint64_t prefix, size_t *probes) {
+    uint64_t hash = key_hash(prefix, key);
+    size_t i = hash & index->mask;
+    for (size_t distance = 0; ; distance++) {
+        const IndexSlot *slot = &index->slots[i];
+        if (slot->node == NULL || slot_distance(index, i) < distance) {
+            *probes = distance + 1;
+            return NULL;
+        }
+        if (slot->hash == hash && node_cmp(slot->node, prefix, key) == 0) {
+            *probes = distance + 1;
+            return slot->node;
+        }
+        i = (i + 1) & index->mask;
+    }
+}
+
+// Bytes malloc'd by the index
+size_t bitree_index_bytes(const BiTreeIndex *index) {
+    return sizeof(BiTreeIndex) + (index->mask + 1) * sizeof(IndexSlot);
+}
+
+void bitree_index_destroy(BiTreeIndex *index) {
+    if (index != NULL) {
+        free(index->slots);
+        free(index);
+    }
+}
@@ -0,0 +1,93 @@
+#ifndef BITREE_INTERNAL_H
+#define BITREE_INTERNAL_H
+
+// AVL node helpers shared by the BiTree translation units. Not installed.
+
+#include "bitree.h"
+#include "key_prefix.h"
+
+#include <limits.h>
+
+// Sign of strcmp(key, node->data) where prefix is key_prefix(key). Most
+// comparisons resolve on the prefix cached in the node, without touching
+// the key bytes.
+static inline int node_cmp(const BiTreeNode *node, uint64_t prefix, const char *key) {
+    if (prefix != node->prefix) {
+        return prefix < node->prefix ? -1 : 1;
+    }
+    if ((prefix & 0xff) == 0) {
+        return 0; // Both keys end inside the prefix
+    }
+    return strcmp(key + 8, node->data + 8);
+}
+
+// Cached heights stop here instead of wrapping around. Only trees that are
+// not AVL balanced, such as deserialized or splayed ones, get this deep.
+#define NODE_HEIGHT_MAX UCHAR_MAX
+
+// Height of a possibly empty subtree, at most NODE_HEIGHT_MAX
+static inline int node_height(const BiTreeNode *node) {
+    return node == NULL ? 0 : node->height;
+}
+
+// Exact height of the subtree at root: the cached one unless it saturated
+static inline int subtree_depth(BiTreeNode *root) {
+    int height = node_height(root);
+    return height < NODE_HEIGHT_MAX ? height : BiTree_depth(root);
+}
+
+// Number of nodes in a possibly empty subtree
+static inline size_t node_size(const BiTreeNode *node) {
+    return node == NULL ? 0 : node->size;
+}
+
+// Recompute the cached height and size of a node from its children
+static inline void node_update(BiTreeNode *node) {
+    int lh = node_height(node->left);
+    int rh = node_height(node->right);
+    int height = 1 + (lh > rh ? lh : rh);
+    node->height = height < NODE_HEIGHT_MAX ? height : NODE_HEIGHT_MAX;
+    node->size = 1 + node_size(node->left) + node_size(node->right);
+}
+
+// Rotate the subtree right around node and return the new subtree root
+static inline BiTreeNode* rotate_right(BiTreeNode *node) {
+    BiTreeNode *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    node_update(node);
+    node_update(pivot);
+    return pivot;
+}
+
+// Rotate the subtree left around node and return the new subtree root
+static inline BiTreeNode* rotate_left(BiTreeNode *node) {
+    BiTreeNode *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    node_update(node);
+    node_update(pivot);
+    return pivot;
+}
+
+// Snapshot loading in steps, for loaders that decode chunks on several
+// threads (bitree_parallel.c). Defined in bitree.c.
+typedef struct SnapshotLoad SnapshotLoad;
+
+SnapshotLoad* bitree_snapshot_open(const char *path);
+size_t bitree_snapshot_chunks(const SnapshotLoad *load);
+BiTreeNode* bitree_snapshot_nodes(const SnapshotLoad *load, uint64_t *count);
+bool bitree_snapshot_decode(SnapshotLoad *load, size_t chunk);
+bool bitree_snapshot_ordered(const SnapshotLoad *load);
+BiTree* bitree_snapshot_finish(SnapshotLoad *load, BiTreeNode *root, bool ok);
+
+// Exact-match hash index kept next to the tree by node allocation and
+// release. Defined in bitree_index.c.
+BiTreeIndex* bitree_index_new(size_t expected);
+bool bitree_index_put(BiTreeIndex *index, BiTreeNode *node);
+void bitree_index_remove(BiTreeIndex *index, const BiTreeNode *node);
+BiTreeNode* bitree_index_get(const BiTreeIndex *index, const char *key, uint64_t prefix, size_t *probes);
+size_t bitree_index_bytes(const BiTreeIndex *index);
+void bitree_index_destroy(BiTreeIndex *index);
+
+#endif // BITREE_INTERNAL_H
@@ -0,0 +1,786 @@
+#include "bitree_log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+
+#ifdef _WIN32
+#include <io.h>
+#include <limits.h>
+#else
+#include <unistd.h>
+#endif
+
+#define LOG_MAGIC "BTWAL\0\0\0"
+#define LOG_BYTE_ORDER 0x01020304u
+
+// Segments hold binary records; the Windows CRT would translate newlines
+#ifdef O_BINARY
+#define LOG_BINARY O_BINARY
+#else
+#define LOG_BINARY 0
+#endif
+
+// Record operations
+#define LOG_INSERT 'I'
+#define LOG_DELETE 'D'
+#define LOG_PUT    'P'          // since version 2: key and the value it now holds
+
+// Longest key a record may carry; anything longer is a corrupt length
+#define LOG_MAX_KEY (1u << 30)
+
+// File header; records follow as {u8 op, u32 length, key bytes, u32 crc}
+// in host byte order, the crc covering op, length and key. Put records
+// carry a u64 value between the key and the crc, covered by it too.
+typedef struct {
+    char magic[8];
+    uint32_t version;
+    uint32_t byte_order;
+} LogHeader;
+
+// Growable byte buffer of encoded records
+typedef struct {
+    unsigned char *data;
+    size_t length;
+    size_t capacity;
+} LogBuffer;
+
+struct BiTreeLog {
+    BiTree *tree;
+    char *snapshot_path;
+    char *wal_path;             // active segment
+    char *frozen_path;          // segment being folded into the snapshot
+    bool durable;
+
+    pthread_mutex_t lock;       // guards everything below and the tree
+    pthread_cond_t flushed;
+    int fd;
+    uint64_t wal_bytes;         // active segment size, pending records included
+    LogBuffer pending;          // records appended but not yet written
+    LogBuffer spare;            // buffer of the flush in flight, recycled
+    uint64_t appended;          // records appended so far
+    uint64_t written;           // records written (and synced when durable)
+    bool flushing;
+    bool failed;
+    uint64_t compact_bytes;     // wal_bytes at which a write compacts
+
+    pthread_t compactor;
+    pthread_cond_t compacted;
+    bool compacting;            // compaction claimed, rotating or running
+    bool starting;              // compactor being launched; the handle is
+                                // the launcher's until this is cleared
+    bool joinable;              // compactor started and not joined yet
+};
+
+// --- CRC-32 (IEEE) -------------------------------------------------------
+
+static uint32_t crc_table[256];
+static pthread_once_t crc_once = PTHREAD_ONCE_INIT;
+
+static void crc_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t crc = i;
+        for (int bit = 0; bit < 8; bit++) {
+            crc = crc & 1 ? (crc >> 1) ^ 0xEDB88320u : crc >> 1;
+        }
+        crc_table[i] = crc;
+    }
+}
+
+static uint32_t crc_update(uint32_t crc, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++) {
+        crc = crc_table[(crc ^ bytes[i]) & 0xff] ^ (crc >> 8);
+    }
+    return ~crc;
+}
+
+// --- file helpers ----------------------------------------------------------
+
+static char* path_with(const char *path, const char *suffix) {
+    size_t length = strlen(path);
+    size_t extra = strlen(suffix);
+    char *joined = malloc(length + extra + 1);
+    if (joined != NULL) {
+        memcpy(joined, path, length);
+        memcpy(joined + length, suffix, extra + 1);
+    }
+    return joined;
+}
+
+static bool path_exists(const char *path) {
+    struct stat st;
+    return stat(path, &st) == 0;
+}
+
+static bool write_all(int fd, const void *data, size_t size) {
+    const unsigned char *bytes = data;
+    while (size > 0) {
+#ifdef _WIN32
+        int written = _write(fd, bytes, size > INT_MAX ? INT_MAX : (unsigned)size);
+#else
+        ssize_t written = write(fd, bytes, size);
+#endif
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        bytes += written;
+        size -= (size_t)written;
+    }
+    return true;
+}
+
+static bool sync_fd(int fd) {
+#if defined(_WIN32)
+    return _commit(fd) == 0;
+#elif defined(__linux__)
+    return fdatasync(fd) == 0;
+#else
+    return fsync(fd) == 0;
+#endif
+}
+
+// Make a file, or a rename/unlink inside a directory, durable. Windows
+// only flushes handles open for writing and cannot open a directory, so
+// there files are opened read-write and directories are skipped: NTFS
+// journals the rename or unlink itself.
+static bool sync_path(const char *path) {
+#ifdef _WIN32
+    int fd = _open(path, _O_RDWR | _O_BINARY);
+#else
+    int fd = open(path, O_RDONLY);
+#endif
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = sync_fd(fd);
+    close(fd);
+    return ok;
+}
+
+// Cut the file at path back to length bytes
+static bool truncate_path(const char *path, long length) {
+#ifdef _WIN32
+    int fd = _open(path, _O_WRONLY | _O_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    bool ok = _chsize_s(fd, length) == 0;
+    _close(fd);
+    return ok;
+#else
+    return truncate(path, length) == 0;
+#endif
+}
+
+static bool sync_parent(const char *path) {
+#ifdef _WIN32
+    (void)path;
+    return true;
+#else
+    char *dir = strdup(path);
+    if (dir == NULL) {
+        return false;
+    }
+    char *slash = strrchr(dir, '/');
+    bool ok;
+    if (slash == NULL) {
+        ok = sync_path(".");
+    } else {
+        slash[slash == dir ? 1 : 0] = '\0';
+        ok = sync_path(dir);
+    }
+    free(dir);
+    return ok;
+#endif
+}
+
+static void buffer_append(LogBuffer *buffer, const void *data, size_t size) {
+    if (buffer->length + size > buffer->capacity) {
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity : 4096;
+        while (capacity < buffer->length + size) {
+            capacity *= 2;
+        }
+        unsigned char *grown = realloc(buffer->data, capacity);
+        if (grown == NULL) {
+            fprintf(stderr, "Memory allocation failed for log buffer.\n");
+            exit(EXIT_FAILURE);
+        }
+        buffer->data = grown;
+        buffer->capacity = capacity;
+    }
+    memcpy(buffer->data + buffer->length, data, size);
+    buffer->length += size;
+}
+
+// --- replay ----------------------------------------------------------------
+
+// Whether op is a record operation of the given segment format version
+static bool record_op(unsigned char op, uint32_t version) {
+    return op == LOG_INSERT || op == LOG_DELETE || (op == LOG_PUT && version >= 2);
+}
+
+static BiTree* load_snapshot(const char *path) {
+    return path_exists(path) ? BiTree_loadSnapshot(path) : BiTree_new(NULL);
+}
+
+// Apply the records of one log segment to tree. A torn or corrupt record
+// ends the replay: it is the tail of a write that never completed. With
+// truncate set the segment is cut back to its last intact record so new
+// records append after it. Returns false if the file is not a log.
+static bool replay(BiTree *tree, const char *path, bool truncate_tail) {
+    FILE *fp = fopen(path, "rb");
+    if (fp == NULL) {
+        return errno == ENOENT;
+    }
+    setvbuf(fp, NULL, _IOFBF, 1 << 20);
+
+    LogHeader header;
+    size_t got = fread(&header, 1, sizeof(header), fp);
+    if (got < sizeof(header)) {
+        // Created, or torn while its header was being written
+        fclose(fp);
+        return got == 0 || !truncate_tail || truncate_path(path, 0);
+    }
+    if (memcmp(header.magic, LOG_MAGIC, sizeof(header.magic)) != 0 || header.byte_order != LOG_BYTE_ORDER
+        || header.version < 1 || header.version > BITREE_LOG_VERSION) {
+        fprintf(stderr, "Invalid write-ahead log %s\n", path);
+        fclose(fp);
+        return false;
+    }
+
+    char *key = NULL;
+    size_t key_capacity = 0;
+    long good = (long)sizeof(header);
+    uint64_t records = 0;
+    for (;;) {
+        unsigned char op;
+        uint32_t length;
+        uint64_t value = 0;
+        uint32_t crc;
+        if (fread(&op, 1, 1, fp) != 1 || fread(&length, sizeof(length), 1, fp) != 1
+            || !record_op(op, header.version) || length > LOG_MAX_KEY) {
+            break;
+        }
+        size_t value_bytes = op == LOG_PUT ? sizeof(value) : 0;
+        if (length + 1 > key_capacity) {
+            key_capacity = length + 1;
+            free(key);
+            key = malloc(key_capacity);
+            if (key == NULL) {
+                fprintf(stderr, "Memory allocation failed for log replay.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        if (fread(key, 1, length, fp) != length || fread(&value, 1, value_bytes, fp) != value_bytes
+            || fread(&crc, sizeof(crc), 1, fp) != 1) {
+            break;
+        }
+        uint32_t expect = crc_update(0, &op, 1);
+        expect = crc_update(expect, &length, sizeof(length));
+        expect = crc_update(expect, key, length);
+        expect = crc_update(expect, &value, value_bytes);
+        if (crc != expect) {
+            break;
+        }
+        key[length] = '\0';
+        if (op == LOG_INSERT) {
+            BiTree_insert(tree, key);
+        } else if (op == LOG_DELETE) {
+            BiTree_delete(tree, key);
+        } else {
+            BiTree_put(tree, key, (BiTreeValue){ .u64 = value });
+        }
+        good = ftell(fp);
+        records++;
+    }
+    free(key);
+
+    fseek(fp, 0, SEEK_END);
+    long size = ftell(fp);
+    fclose(fp);
+    if (size > good) {
+        fprintf(stderr, "%s: dropping %ld bytes of torn log tail after %llu records\n",
+                path, size - good, (unsigned long long)records);
+        if (truncate_tail && !truncate_path(path, good)) {
+            fprintf(stderr, "Error truncating %s\n", path);
+            return false;
+        }
+    }
+    return true;
+}
+
+// Raise the version in the header of an existing segment, which replay
+// has already checked, before records of the current version follow its
+// older ones
+static bool stamp_version(const char *path) {
+    int fd = open(path, O_RDWR | LOG_BINARY);
+    if (fd < 0) {
+        return false;
+    }
+    LogHeader header;
+    bool ok = read(fd, &header, sizeof(header)) == (long)sizeof(header);
+    if (ok && header.version < BITREE_LOG_VERSION) {
+        header.version = BITREE_LOG_VERSION;
+        ok = lseek(fd, 0, SEEK_SET) == 0 && write_all(fd, &header, sizeof(header)) && sync_fd(fd);
+    }
+    close(fd);
+    return ok;
+}
+
+// Open the active segment for appending, writing the header if it is new
+static int open_segment(const char *path, uint64_t *size) {
+    int fd = open(path, O_WRONLY | O_CREAT | O_APPEND | LOG_BINARY, 0644);
+    if (fd < 0) {
+        fprintf(stderr, "Error opening write-ahead log %s\n", path);
+        return -1;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return -1;
+    }
+    *size = (uint64_t)st.st_size;
+    if (*size > 0 && !stamp_version(path)) {
+        fprintf(stderr, "Error upgrading write-ahead log %s\n", path);
+        close(fd);
+        return -1;
+    }
+    if (*size == 0) {
+        LogHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, LOG_MAGIC, sizeof(header.magic));
+        header.version = BITREE_LOG_VERSION;
+        header.byte_order = LOG_BYTE_ORDER;
+        if (!write_all(fd, &header, sizeof(header)) || !sync_fd(fd) || !sync_parent(path)) {
+            fprintf(stderr, "Error writing write-ahead log %s\n", path);
+            close(fd);
+            return -1;
+        }
+        *size = sizeof(header);
+    }
+    return fd;
+}
+
+// --- group commit ----------------------------------------------------------
+
+// Queue a record; value is written for put records only
+static void append_record(BiTreeLog *log, char op, const char *key, uint32_t length, uint64_t value) {
+    unsigned char byte = (unsigned char)op;
+    size_t value_bytes = op == LOG_PUT ? sizeof(value) : 0;
+    uint32_t crc = crc_update(0, &byte, 1);
+    crc = crc_update(crc, &length, sizeof(length));
+    crc = crc_update(crc, key, length);
+    crc = crc_update(crc, &value, value_bytes);
+    buffer_append(&log->pending, &byte, 1);
+    buffer_append(&log->pending, &length, sizeof(length));
+    buffer_append(&log->pending, key, length);
+    buffer_append(&log->pending, &value, value_bytes);
+    buffer_append(&log->pending, &crc, sizeof(crc));
+    log->wal_bytes += 1 + sizeof(length) + length + value_bytes + sizeof(crc);
+    log->appended++;
+}
+
+// Wait until the first target records are written. The first writer to
+// find no flush in flight becomes the leader: it takes every pending
+// record, writes and syncs them with the lock released, then wakes the
+// writers whose records went out with it. Called with the lock held.
+static bool commit(BiTreeLog *log, uint64_t target) {
+    while (!log->failed && log->written < target) {
+        if (log->flushing) {
+            pthread_cond_wait(&log->flushed, &log->lock);
+            continue;
+        }
+        log->flushing = true;
+        LogBuffer batch = log->pending;
+        log->pending = log->spare;
+        uint64_t upto = log->appended;
+        int fd = log->fd;
+        pthread_mutex_unlock(&log->lock);
+
+        bool ok = write_all(fd, batch.data, batch.length) && (!log->durable || sync_fd(fd));
+
+        pthread_mutex_lock(&log->lock);
+        batch.length = 0;
+        log->spare = batch;
+        log->flushing = false;
+        if (ok) {
+            log->written = upto;
+        } else {
+            fprintf(stderr, "Error writing write-ahead log %s\n", log->wal_path);
+            log->failed = true;
+        }
+        pthread_cond_broadcast(&log->flushed);
+    }
+    return !log->failed;
+}
+
+// Write out everything appended so far, leaving no flush in flight.
+// Called with the lock held.
+static bool drain(BiTreeLog *log) {
+    while (!log->failed && (log->flushing || log->written < log->appended)) {
+        commit(log, log->appended);
+    }
+    return !log->failed;
+}
+
+// --- compaction ------------------------------------------------------------
+
+// Fold the frozen segment into a new snapshot on a private tree, then drop
+// the segment. A crash anywhere in between leaves the segment in place
+// and recovery replays it; replaying it over a snapshot that already
+// contains it changes nothing.
+static void* compact_main(void *arg) {
+    BiTreeLog *log = arg;
+    BiTree *tree = load_snapshot(log->snapshot_path);
+    bool ok = tree != NULL
+        && replay(tree, log->frozen_path, false)
+        && BiTree_saveSnapshot(tree, log->snapshot_path)
+        && sync_path(log->snapshot_path)
+        && sync_parent(log->snapshot_path)
+        && remove(log->frozen_path) == 0
+        && sync_parent(log->frozen_path);
+    BiTree_destroy(tree);
+    if (!ok) {
+        fprintf(stderr, "Compaction of %s failed, will retry\n", log->frozen_path);
+    }
+
+    pthread_mutex_lock(&log->lock);
+    log->compacting = false;
+    pthread_cond_broadcast(&log->compacted);
+    pthread_mutex_unlock(&log->lock);
+    return NULL;
+}
+
+// Claim the compactor for a caller that calls launch_compactor once it has
+// released the lock. Returns false if a compaction is already claimed.
+// Called with the lock held.
+static bool claim_compactor(BiTreeLog *log) {
+    if (log->compacting || log->starting) {
+        return false;
+    }
+    log->compacting = true;
+    log->starting = true;
+    return true;
+}
+
+// Give up a claim without starting a compactor. Called with the lock held.
+static void release_compactor(BiTreeLog *log) {
+    log->compacting = false;
+    log->starting = false;
+    pthread_cond_broadcast(&log->compacted);
+}
+
+// Start the compactor claimed by claim_compactor. Runs without the lock,
+// since joining the previous compactor may wait for it to give the lock
+// up. While starting is set no one else touches the thread handle.
+static bool launch_compactor(BiTreeLog *log) {
+    if (log->joinable) {
+        pthread_join(log->compactor, NULL); // done with the log, see compacting
+        log->joinable = false;
+    }
+    pthread_t thread;
+    bool ok = pthread_create(&thread, NULL, compact_main, log) == 0;
+    if (!ok) {
+        fprintf(stderr, "Failed to start compaction of %s\n", log->wal_path);
+    }
+
+    pthread_mutex_lock(&log->lock);
+    if (ok) {
+        log->compactor = thread;
+        log->joinable = true;
+        log->starting = false;
+        pthread_cond_broadcast(&log->compacted);
+    } else {
+        release_compactor(log);
+    }
+    pthread_mutex_unlock(&log->lock);
+    return ok;
+}
+
+// Freeze the active segment so it can be folded into the snapshot. A
+// frozen segment left by an earlier failed run is folded first instead.
+// Returns true if the caller is to launch_compactor after releasing the
+// lock. Called with the lock held.
+static bool rotate_and_compact(BiTreeLog *log) {
+    // The claim comes first: drain releases the lock, and writers that
+    // cross the threshold meanwhile must not rotate the segment again
+    if (!claim_compactor(log)) {
+        return false;
+    }
+    if (path_exists(log->frozen_path)) {
+        return true;
+    }
+    if (!drain(log) || !sync_fd(log->fd)) {
+        release_compactor(log);
+        return false;
+    }
+    close(log->fd);
+    bool frozen = rename(log->wal_path, log->frozen_path) == 0;
+    if (!frozen) {
+        fprintf(stderr, "Error freezing write-ahead log %s\n", log->wal_path);
+    }
+    // A failed rename reopens the same segment and keeps appending to it
+    log->fd = open_segment(log->wal_path, &log->wal_bytes);
+    if (log->fd < 0) {
+        log->failed = true;
+        frozen = false;
+    }
+    if (!frozen) {
+        release_compactor(log);
+    }
+    return frozen;
+}
+
+// --- public API --------------------------------------------------------------
+
+BiTreeLog* BiTreeLog_open(const char *path, bool durable) {
+    if (path == NULL) {
+        return NULL;
+    }
+    pthread_once(&crc_once, crc_init);
+
+    BiTreeLog *log = calloc(1, sizeof(BiTreeLog));
+    if (log == NULL) {
+        fprintf(stderr, "Failed to create a new BiTreeLog\n");
+        return NULL;
+    }
+    log->snapshot_path = strdup(path);
+    log->wal_path = path_with(path, ".wal");
+    log->frozen_path = path_with(path, ".wal.1");
+    log->durable = durable;
+    log->compact_bytes = BITREE_LOG_COMPACT_BYTES;
+    log->fd = -1;
+    pthread_mutex_init(&log->lock, NULL);
+    pthread_cond_init(&log->flushed, NULL);
+    pthread_cond_init(&log->compacted, NULL);
+
+    bool ok = log->snapshot_path != NULL && log->wal_path != NULL && log->frozen_path != NULL
+        && (log->tree = load_snapshot(path)) != NULL;
+    bool frozen = ok && path_exists(log->frozen_path);
+    ok = ok && (!frozen || replay(log->tree, log->frozen_path, false))
+        && replay(log->tree, log->wal_path, true)
+        && (log->fd = open_segment(log->wal_path, &log->wal_bytes)) >= 0;
+    if (!ok) {
+        BiTreeLog_close(log);
+        return NULL;
+    }
+
+    // Finish the compaction a crash interrupted
+    if (frozen) {
+        pthread_mutex_lock(&log->lock);
+        claim_compactor(log);
+        pthread_mutex_unlock(&log->lock);
+        launch_compactor(log);
+    }
+    return log;
+}
+
+// Flush and close the log; waits for a running compaction first. Returns
+// false if any write was lost.
+bool BiTreeLog_close(BiTreeLog *log) {
+    if (log == NULL) {
+        return true;
+    }
+    BiTreeLog_waitCompaction(log);
+
+    pthread_mutex_lock(&log->lock);
+    bool ok = true;
+    if (log->fd >= 0) {
+        ok = drain(log) && sync_fd(log->fd);
+        close(log->fd);
+    }
+    ok = ok && !log->failed;
+    pthread_mutex_unlock(&log->lock);
+
+    BiTree_destroy(log->tree);
+    pthread_mutex_destroy(&log->lock);
+    pthread_cond_destroy(&log->flushed);
+    pthread_cond_destroy(&log->compacted);
+    free(log->pending.data);
+    free(log->spare.data);
+    free(log->snapshot_path);
+    free(log->wal_path);
+    free(log->frozen_path);
+    free(log);
+    return ok;
+}
+
+// Append a record of a change already made to the tree and wait until it
+// is written, rotating the segment once it is large enough. Called with
+// the lock held; sets *launch if the caller has to start the compactor
+// once it has unlocked.
+static bool log_record(BiTreeLog *log, char op, const char *key, size_t length, uint64_t value, bool *launch) {
+    append_record(log, op, key, (uint32_t)length, value);
+    bool ok = commit(log, log->appended);
+    if (ok && log->wal_bytes >= log->compact_bytes) {
+        *launch = rotate_and_compact(log);
+    }
+    return ok;
+}
+
+static bool log_write(BiTreeLog *log, char op, const char *key) {
+    if (log == NULL || key == NULL) {
+        return false;
+    }
+    size_t length = strlen(key);
+    if (length > LOG_MAX_KEY) {
+        return false;
+    }
+
+    pthread_mutex_lock(&log->lock);
+    bool changed = false;
+    bool launch = false;
+    if (!log->failed) {
+        changed = op == LOG_INSERT ? BiTree_insert(log->tree, key) : BiTree_delete(log->tree, key);
+    }
+    if (changed) {
+        changed = log_record(log, op, key, length, 0, &launch);
+    }
+    pthread_mutex_unlock(&log->lock);
+    if (launch) {
+        launch_compactor(log);
+    }
+    return changed;
+}
+
+// Store value under key, or with add set add it to what the key holds,
+// and log the value the key ends up with, so replay never has to read
+// the old one. That value goes to *result if it is not NULL.
+static bool log_put(BiTreeLog *log, const char *key, BiTreeValue value, bool add, BiTreeValue *result) {
+    if (log == NULL || key == NULL) {
+        return false;
+    }
+    size_t length = strlen(key);
+    if (length > LOG_MAX_KEY) {
+        return false;
+    }
+
+    pthread_mutex_lock(&log->lock);
+    bool ok = false;
+    bool launch = false;
+    BiTreeValue *slot = log->failed ? NULL : BiTree_getOrInsert(log->tree, key, NULL);
+    if (slot != NULL) {
+        if (add) {
+            slot->u64 += value.u64; // wraps like a two's complement int64 add
+        } else {
+            *slot = value;
+        }
+        value = *slot;
+        ok = log_record(log, LOG_PUT, key, length, value.u64, &launch);
+    }
+    pthread_mutex_unlock(&log->lock);
+    if (launch) {
+        launch_compactor(log);
+    }
+    if (ok && result != NULL) {
+        *result = value;
+    }
+    return ok;
+}
+
+bool BiTreeLog_insert(BiTreeLog *log, const char *key) {
+    return log_write(log, LOG_INSERT, key);
+}
+
+bool BiTreeLog_delete(BiTreeLog *log, const char *key) {
+    return log_write(log, LOG_DELETE, key);
+}
+
+bool BiTreeLog_put(BiTreeLog *log, const char *key, BiTreeValue value) {
+    return log_put(log, key, value, false, NULL);
+}
+
+bool BiTreeLog_incr(BiTreeLog *log, const char *key, int64_t delta, int64_t *result) {
+    BiTreeValue value;
+    if (!log_put(log, key, (BiTreeValue){ .i64 = delta }, true, &value)) {
+        return false;
+    }
+    if (result != NULL) {
+        *result = value.i64;
+    }
+    return true;
+}
+
+bool BiTreeLog_get(BiTreeLog *log, const char *key, BiTreeValue *value) {
+    if (log == NULL || key == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&log->lock);
+    bool found = BiTree_get(log->tree, key, value);
+    pthread_mutex_unlock(&log->lock);
+    return found;
+}
+
+bool BiTreeLog_contains(BiTreeLog *log, const char *key) {
+    if (log == NULL || key == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&log->lock);
+    bool found = BiTree_lookup(log->tree, key) != NULL;
+    pthread_mutex_unlock(&log->lock);
+    return found;
+}
+
+size_t BiTreeLog_size(BiTreeLog *log) {
+    if (log == NULL) {
+        return 0;
+    }
+    pthread_mutex_lock(&log->lock);
+    size_t count = log->tree->node_count;
+    pthread_mutex_unlock(&log->lock);
+    return count;
+}
+
+// Make every write so far durable, for logs opened without durable
+bool BiTreeLog_sync(BiTreeLog *log) {
+    if (log == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&log->lock);
+    bool ok = drain(log) && sync_fd(log->fd);
+    pthread_mutex_unlock(&log->lock);
+    return ok;
+}
+
+// Start a background compaction; false if one is already running
+bool BiTreeLog_compact(BiTreeLog *log) {
+    if (log == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&log->lock);
+    bool started = !log->failed && rotate_and_compact(log);
+    pthread_mutex_unlock(&log->lock);
+    return started && launch_compactor(log);
+}
+
+// Active log size at which a write starts a compaction, by default
+// BITREE_LOG_COMPACT_BYTES
+void BiTreeLog_setCompactBytes(BiTreeLog *log, uint64_t bytes) {
+    if (log == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&log->lock);
+    log->compact_bytes = bytes;
+    pthread_mutex_unlock(&log->lock);
+}
+
+void BiTreeLog_waitCompaction(BiTreeLog *log) {
+    pthread_mutex_lock(&log->lock);
+    while (log->compacting || log->starting) {
+        pthread_cond_wait(&log->compacted, &log->lock);
+    }
+    // Joined without the lock; only this caller saw the handle
+    bool reap = log->joinable;
+    pthread_t compactor = log->compactor;
+    log->joinable = false;
+    pthread_mutex_unlock(&log->lock);
+    if (reap) {
+        pthread_join(compactor, NULL);
+    }
+}
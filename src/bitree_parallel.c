@@ -0,0 +1,395 @@
+#include "bitree_parallel.h"
+#include "bitree_internal.h"
+
+#include <stdarg.h>
+
+// Heap indices beyond this cannot belong to a complete tree that fits in
+// memory, and doubling them further would overflow
+#define MAX_COMPLETE_INDEX (UINT64_C(1) << 62)
+
+// One subtree of a forked operation and its partial result
+typedef struct {
+    TaskPool *pool;
+    BiTreeNode *node;
+    int split;              // levels left at which to fork
+    uint64_t index;         // heap index of node, for iscomplete
+    int depth;
+    bool full;
+    size_t count;
+    uint64_t max_index;
+    bool overflow;
+} SubtreeTask;
+
+// Number of levels to fork so that every worker sees several subtrees
+static int split_levels(TaskPool *pool) {
+    int levels = 0;
+    while ((1 << levels) < TaskPool_threads(pool) * 8 && levels < 16) {
+        levels++;
+    }
+    return levels;
+}
+
+static SubtreeTask subtree_task(const SubtreeTask *parent, BiTreeNode *node, uint64_t index) {
+    SubtreeTask task = *parent;
+    task.node = node;
+    task.split = parent->split - 1;
+    task.index = index;
+    return task;
+}
+
+// Run fn on both children of task->node, the left one as a stolen-able task
+static void fork_children(SubtreeTask *task, TaskPool_fn fn, SubtreeTask *left, SubtreeTask *right) {
+    *left = subtree_task(task, task->node->left, 2 * task->index + 1);
+    *right = subtree_task(task, task->node->right, 2 * task->index + 2);
+    TaskGroup group = TASKGROUP_INIT;
+    TaskPool_spawn(task->pool, &group, fn, left);
+    fn(right);
+    TaskPool_wait(task->pool, &group);
+}
+
+static void free_task(void *arg) {
+    SubtreeTask *task = arg;
+    if (task->node == NULL || task->split == 0) {
+        BiTree_free(task->node);
+        return;
+    }
+    SubtreeTask left, right;
+    fork_children(task, free_task, &left, &right);
+    task->node->left = NULL;
+    task->node->right = NULL;
+    BiTree_free(task->node);
+}
+
+static void depth_task(void *arg) {
+    SubtreeTask *task = arg;
+    if (task->node == NULL || task->split == 0) {
+        task->depth = BiTree_depth(task->node);
+        return;
+    }
+    SubtreeTask left, right;
+    fork_children(task, depth_task, &left, &right);
+    task->depth = 1 + (left.depth > right.depth ? left.depth : right.depth);
+}
+
+static void isfull_task(void *arg) {
+    SubtreeTask *task = arg;
+    BiTreeNode *node = task->node;
+    if (node == NULL || task->split == 0 || (node->left == NULL) != (node->right == NULL)) {
+        task->full = BiTree_isfull(node);
+        return;
+    }
+    if (node->left == NULL) {
+        task->full = true;
+        return;
+    }
+    SubtreeTask left, right;
+    fork_children(task, isfull_task, &left, &right);
+    task->full = left.full && right.full;
+}
+
+// Count nodes and track the largest heap index below node. A tree is
+// complete exactly when its n nodes use heap indices 0 .. n-1.
+static void complete_scan(BiTreeNode *node, uint64_t index, SubtreeTask *task) {
+    if (node == NULL || task->overflow) {
+        return;
+    }
+    if (index >= MAX_COMPLETE_INDEX) {
+        task->overflow = true;
+        return;
+    }
+    task->count++;
+    if (index > task->max_index) {
+        task->max_index = index;
+    }
+    complete_scan(node->left, 2 * index + 1, task);
+    complete_scan(node->right, 2 * index + 2, task);
+}
+
+static void iscomplete_task(void *arg) {
+    SubtreeTask *task = arg;
+    task->count = 0;
+    task->max_index = 0;
+    task->overflow = false;
+    if (task->node == NULL || task->split == 0 || task->index >= MAX_COMPLETE_INDEX) {
+        complete_scan(task->node, task->index, task);
+        return;
+    }
+    SubtreeTask left, right;
+    fork_children(task, iscomplete_task, &left, &right);
+    task->count = 1 + left.count + right.count;
+    task->max_index = task->index;
+    if (left.count > 0 && left.max_index > task->max_index) {
+        task->max_index = left.max_index;
+    }
+    if (right.count > 0 && right.max_index > task->max_index) {
+        task->max_index = right.max_index;
+    }
+    task->overflow = left.overflow || right.overflow;
+}
+
+static SubtreeTask root_task(TaskPool *pool, BiTreeNode *root) {
+    SubtreeTask task;
+    memset(&task, 0, sizeof(task));
+    task.pool = pool;
+    task.node = root;
+    task.split = split_levels(pool);
+    return task;
+}
+
+void BiTree_freeParallel(TaskPool *pool, BiTreeNode *root) {
+    SubtreeTask task = root_task(pool, root);
+    free_task(&task);
+}
+
+void BiTree_destroyParallel(TaskPool *pool, BiTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    if (tree->arena != NULL) {
+        // Arena trees are released block by block, there is no walk to split
+        BiTree_destroy(tree);
+        return;
+    }
+    BiTree_freeParallel(pool, tree->root);
+    tree->root = NULL;
+    BiTree_destroy(tree);
+}
+
+int BiTree_depthParallel(TaskPool *pool, BiTreeNode *root) {
+    SubtreeTask task = root_task(pool, root);
+    depth_task(&task);
+    return task.depth;
+}
+
+bool BiTree_isfullParallel(TaskPool *pool, BiTreeNode *root) {
+    SubtreeTask task = root_task(pool, root);
+    isfull_task(&task);
+    return task.full;
+}
+
+bool BiTree_iscompleteParallel(TaskPool *pool, BiTreeNode *root) {
+    SubtreeTask task = root_task(pool, root);
+    iscomplete_task(&task);
+    return !task.overflow && (task.count == 0 || task.max_index + 1 == task.count);
+}
+
+// Growable text buffer a subtree is rendered into
+typedef struct {
+    char *data;
+    size_t length;
+    size_t capacity;
+} TextBuffer;
+
+static void buffer_printf(TextBuffer *buffer, const char *format, ...) {
+    for (;;) {
+        va_list args;
+        va_start(args, format);
+        size_t room = buffer->capacity - buffer->length;
+        int written = vsnprintf(buffer->data + buffer->length, room, format, args);
+        va_end(args);
+        if (written < 0) {
+            fprintf(stderr, "Formatting failed while serializing.\n");
+            exit(EXIT_FAILURE);
+        }
+        if ((size_t)written < room) {
+            buffer->length += written;
+            return;
+        }
+        size_t capacity = buffer->capacity > 0 ? buffer->capacity * 2 : 4096;
+        while (capacity - buffer->length <= (size_t)written) {
+            capacity *= 2;
+        }
+        char *data = realloc(buffer->data, capacity);
+        if (data == NULL) {
+            fprintf(stderr, "Memory allocation failed for serialize buffer.\n");
+            exit(EXIT_FAILURE);
+        }
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+}
+
+// Same record layout as the "dfs" branch of BiTree_serialize, with the same
+// explicit stack so deep subtrees do not recurse
+static void render_dfs(TextBuffer *buffer, BiTreeNode *root) {
+    size_t capacity = 64;
+    size_t top = 0;
+    BiTreeNode **stack = malloc(capacity * sizeof(BiTreeNode *));
+    if (stack == NULL) {
+        fprintf(stderr, "Memory allocation failed for render stack.\n");
+        exit(EXIT_FAILURE);
+    }
+    stack[top++] = root;
+    while (top > 0) {
+        BiTreeNode *node = stack[--top];
+        if (node == NULL) {
+            buffer_printf(buffer, "#\n");
+            continue;
+        }
+        buffer_printf(buffer, "%lld %zu %s\n", (long long)node->value.i64, strlen(node->data), node->data);
+        if (top + 2 > capacity) {
+            capacity *= 2;
+            stack = realloc(stack, capacity * sizeof(BiTreeNode *));
+            if (stack == NULL) {
+                fprintf(stderr, "Memory reallocation failed for render stack.\n");
+                exit(EXIT_FAILURE);
+            }
+        }
+        stack[top++] = node->right;
+        stack[top++] = node->left;
+    }
+    free(stack);
+}
+
+typedef struct {
+    BiTreeNode *node;
+    TextBuffer text;
+} RenderTask;
+
+static void render_task(void *arg) {
+    RenderTask *task = arg;
+    render_dfs(&task->text, task->node);
+}
+
+// Collect the non-empty subtrees hanging at depth levels, in preorder
+static void collect_frontier(BiTreeNode *node, int levels, RenderTask *tasks, size_t *count) {
+    if (node == NULL) {
+        return;
+    }
+    if (levels == 0) {
+        tasks[(*count)++].node = node;
+        return;
+    }
+    collect_frontier(node->left, levels - 1, tasks, count);
+    collect_frontier(node->right, levels - 1, tasks, count);
+}
+
+// Write the top levels directly and splice in the rendered subtrees
+static void emit_top(FILE *fp, BiTreeNode *node, int levels, RenderTask *tasks, size_t *next) {
+    if (node == NULL) {
+        fprintf(fp, "#\n");
+        return;
+    }
+    if (levels == 0) {
+        RenderTask *task = &tasks[(*next)++];
+        fwrite(task->text.data, 1, task->text.length, fp);
+        return;
+    }
+    fprintf(fp, "%lld %zu %s\n", (long long)node->value.i64, strlen(node->data), node->data);
+    emit_top(fp, node->left, levels - 1, tasks, next);
+    emit_top(fp, node->right, levels - 1, tasks, next);
+}
+
+// Depth-first serialization with subtrees rendered in parallel. The output
+// is byte-for-byte what BiTree_serialize writes; other algorithms fall
+// back to it.
+void BiTree_serializeParallel(TaskPool *pool, FILE *fp, BiTreeNode *root, const char *algo) {
+    if (root == NULL || strcmp(algo, "dfs") != 0) {
+        BiTree_serialize(fp, root, algo);
+        return;
+    }
+
+    int levels = split_levels(pool);
+    RenderTask *tasks = calloc((size_t)1 << levels, sizeof(RenderTask));
+    if (tasks == NULL) {
+        BiTree_serialize(fp, root, algo);
+        return;
+    }
+    size_t count = 0;
+    collect_frontier(root, levels, tasks, &count);
+
+    TaskGroup group = TASKGROUP_INIT;
+    for (size_t i = 0; i < count; i++) {
+        TaskPool_spawn(pool, &group, render_task, &tasks[i]);
+    }
+    TaskPool_wait(pool, &group);
+
+    size_t next = 0;
+    emit_top(fp, root, levels, tasks, &next);
+    for (size_t i = 0; i < count; i++) {
+        free(tasks[i].text.data);
+    }
+    free(tasks);
+}
+
+// One chunk of a snapshot being loaded
+typedef struct {
+    SnapshotLoad *load;
+    size_t chunk;
+    atomic_bool *ok;
+} DecodeTask;
+
+static void decode_task(void *arg) {
+    DecodeTask *task = arg;
+    if (!bitree_snapshot_decode(task->load, task->chunk)) {
+        atomic_store(task->ok, false);
+    }
+}
+
+// Nodes in key order to link into a balanced subtree, split as in
+// build_balanced so the result matches the sequential loader
+typedef struct {
+    TaskPool *pool;
+    BiTreeNode *nodes;
+    uint64_t count;
+    int split;              // levels left at which to fork
+    BiTreeNode *root;
+} LinkTask;
+
+static void link_task(void *arg) {
+    LinkTask *task = arg;
+    if (task->count == 0) {
+        task->root = NULL;
+        return;
+    }
+    uint64_t mid = task->count / 2;
+    LinkTask left = { task->pool, task->nodes, mid, task->split - 1, NULL };
+    LinkTask right = { task->pool, task->nodes + mid + 1, task->count - mid - 1, task->split - 1, NULL };
+    if (task->split > 0) {
+        TaskGroup group = TASKGROUP_INIT;
+        TaskPool_spawn(task->pool, &group, link_task, &left);
+        link_task(&right);
+        TaskPool_wait(task->pool, &group);
+    } else {
+        link_task(&left);
+        link_task(&right);
+    }
+    BiTreeNode *root = &task->nodes[mid];
+    root->left = left.root;
+    root->right = right.root;
+    node_update(root);
+    task->root = root;
+}
+
+// Load a snapshot written by BiTree_saveSnapshot, checking and decoding its
+// chunks on the pool and linking the top levels of the tree in parallel.
+// The tree is the one BiTree_loadSnapshot builds.
+BiTree* BiTree_loadSnapshotParallel(TaskPool *pool, const char *path) {
+    SnapshotLoad *load = bitree_snapshot_open(path);
+    if (load == NULL) {
+        return NULL;
+    }
+    size_t chunks = bitree_snapshot_chunks(load);
+    DecodeTask *tasks = malloc((chunks > 0 ? chunks : 1) * sizeof(DecodeTask));
+    if (tasks == NULL) {
+        fprintf(stderr, "Memory allocation failed for snapshot load.\n");
+        return bitree_snapshot_finish(load, NULL, false);
+    }
+    atomic_bool ok;
+    atomic_init(&ok, true);
+    TaskGroup group = TASKGROUP_INIT;
+    for (size_t i = 0; i < chunks; i++) {
+        tasks[i] = (DecodeTask){ load, i, &ok };
+        TaskPool_spawn(pool, &group, decode_task, &tasks[i]);
+    }
+    TaskPool_wait(pool, &group);
+    free(tasks);
+    if (!atomic_load(&ok) || !bitree_snapshot_ordered(load)) {
+        return bitree_snapshot_finish(load, NULL, false);
+    }
+
+    LinkTask link = { pool, NULL, 0, split_levels(pool), NULL };
+    link.nodes = bitree_snapshot_nodes(load, &link.count);
+    link_task(&link);
+    return bitree_snapshot_finish(load, link.root, true);
+}
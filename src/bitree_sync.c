@@ -0,0 +1,456 @@
+#include "bitree_sync.h"
+#include "bitree_internal.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+
+struct BiTreeSyncReader {
+    _Alignas(64) _Atomic uint64_t epoch;    // epoch pinned at, 0 when idle
+    atomic_bool used;
+    BiTreeSync *map;
+};
+
+// A version handed out by BiTreeSync_snapshot. It holds back reclamation
+// like a pinned reader, but is not tied to a thread or a reader slot.
+struct BiTreeSyncVersion {
+    BiTreeNode *root;
+    size_t count;
+    uint64_t epoch;             // epoch the version was taken in
+    _Atomic size_t refs;
+    BiTreeSync *map;
+    BiTreeSyncVersion *prev;    // live versions, oldest first, guarded by write_lock
+    BiTreeSyncVersion *next;
+};
+
+// A node unlinked by a write, freed once no reader can still reach it
+typedef struct {
+    BiTreeNode *node;
+    uint64_t epoch;
+} Retired;
+
+struct BiTreeSync {
+    _Atomic(BiTreeNode *) root;
+    _Atomic uint64_t epoch;
+    _Atomic size_t count;
+
+    // Writer-only state, guarded by write_lock
+    pthread_mutex_t write_lock;
+    BiTreeNode **fresh;         // copies made by the write in progress
+    size_t fresh_count;
+    size_t fresh_capacity;
+    Retired *retired;           // oldest first; retired[retired_head..] pending
+    size_t retired_head;
+    size_t retired_count;
+    size_t retired_capacity;
+    BiTreeSyncVersion *versions;        // live versions, oldest first
+    BiTreeSyncVersion *versions_tail;
+
+    BiTreeSyncReader readers[BITREE_SYNC_MAX_READERS];
+};
+
+// Grow a writer-side array; allocation failure mid-write is fatal like the
+// traversal buffers in bitree.c
+static void* reserve(void *items, size_t count, size_t *capacity, size_t size) {
+    if (count < *capacity) {
+        return items;
+    }
+    *capacity = *capacity > 0 ? *capacity * 2 : 64;
+    items = realloc(items, *capacity * size);
+    if (items == NULL) {
+        fprintf(stderr, "Memory allocation failed for BiTreeSync writer.\n");
+        exit(EXIT_FAILURE);
+    }
+    return items;
+}
+
+// Free a node that no reader can reach any more. Keys of nodes that were
+// copied moved to the copy, so only the node itself goes.
+static void release_node(BiTreeNode *node) {
+    if (node->flags & BITREE_NODE_HEAPKEY) {
+        free(node->data);
+    }
+    free(node);
+}
+
+static void retire(BiTreeSync *map, BiTreeNode *node) {
+    map->retired = reserve(map->retired, map->retired_count, &map->retired_capacity, sizeof(Retired));
+    map->retired[map->retired_count].node = node;
+    map->retired[map->retired_count].epoch = 0; // stamped when the write publishes
+    map->retired_count++;
+}
+
+static void track_fresh(BiTreeSync *map, BiTreeNode *node) {
+    node->flags |= BITREE_NODE_FRESH;
+    map->fresh = reserve(map->fresh, map->fresh_count, &map->fresh_capacity, sizeof(BiTreeNode *));
+    map->fresh[map->fresh_count++] = node;
+}
+
+// Return a private, writable version of node for the write in progress.
+// Published nodes are copied; the original is retired and hands its key
+// over to the copy.
+static BiTreeNode* cow(BiTreeSync *map, BiTreeNode *node) {
+    if (node->flags & BITREE_NODE_FRESH) {
+        return node;
+    }
+    BiTreeNode *copy = malloc(sizeof(BiTreeNode));
+    if (copy == NULL) {
+        fprintf(stderr, "Memory allocation failed for BiTreeSync node.\n");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(copy, node, sizeof(BiTreeNode));
+    if (node->data == node->inline_data) {
+        copy->data = copy->inline_data;
+    }
+    node->flags &= ~BITREE_NODE_HEAPKEY;
+    retire(map, node);
+    track_fresh(map, copy);
+    return copy;
+}
+
+// AVL rebalance on private nodes: any node a rotation rewires is copied first
+static BiTreeNode* rebalance(BiTreeSync *map, BiTreeNode *node) {
+    node_update(node);
+    int balance = node_height(node->left) - node_height(node->right);
+
+    if (balance > 1) {
+        node->left = cow(map, node->left);
+        if (node_height(node->left->left) < node_height(node->left->right)) {
+            node->left->right = cow(map, node->left->right);
+            node->left = rotate_left(node->left);
+        }
+        return rotate_right(node);
+    }
+    if (balance < -1) {
+        node->right = cow(map, node->right);
+        if (node_height(node->right->right) < node_height(node->right->left)) {
+            node->right->left = cow(map, node->right->left);
+            node->right = rotate_right(node->right);
+        }
+        return rotate_left(node);
+    }
+    return node;
+}
+
+// Path-copying insert; untouched subtrees are shared with the old version
+static BiTreeNode* insert_rec(BiTreeSync *map, BiTreeNode *node, const char *key, uint64_t prefix, bool *inserted) {
+    if (node == NULL) {
+        BiTreeNode *created = BiTree_createNode(key);
+        if (created == NULL) {
+            fprintf(stderr, "Memory allocation failed for BiTreeSync node.\n");
+            exit(EXIT_FAILURE);
+        }
+        track_fresh(map, created);
+        *inserted = true;
+        return created;
+    }
+
+    int cmp = node_cmp(node, prefix, key);
+    if (cmp == 0) {
+        return node;
+    }
+    BiTreeNode *child = insert_rec(map, cmp < 0 ? node->left : node->right, key, prefix, inserted);
+    if (!*inserted) {
+        return node; // Nothing changed below: keep sharing this node
+    }
+    node = cow(map, node);
+    if (cmp < 0) {
+        node->left = child;
+    } else {
+        node->right = child;
+    }
+    return rebalance(map, node);
+}
+
+static BiTreeNode* detach_min(BiTreeSync *map, BiTreeNode *node, BiTreeNode **min) {
+    if (node->left == NULL) {
+        *min = node;
+        return node->right;
+    }
+    BiTreeNode *child = detach_min(map, node->left, min);
+    node = cow(map, node);
+    node->left = child;
+    return rebalance(map, node);
+}
+
+// Path-copying delete
+static BiTreeNode* delete_rec(BiTreeSync *map, BiTreeNode *node, const char *key, uint64_t prefix, bool *removed) {
+    if (node == NULL) {
+        return NULL;
+    }
+
+    int cmp = node_cmp(node, prefix, key);
+    if (cmp == 0) {
+        BiTreeNode *replacement;
+        if (node->left == NULL) {
+            replacement = node->right;
+        } else if (node->right == NULL) {
+            replacement = node->left;
+        } else {
+            BiTreeNode *successor;
+            BiTreeNode *right = detach_min(map, node->right, &successor);
+            successor = cow(map, successor);
+            successor->left = node->left;
+            successor->right = right;
+            replacement = rebalance(map, successor);
+        }
+        // The removed node keeps its key; both go once readers are done
+        retire(map, node);
+        *removed = true;
+        return replacement;
+    }
+
+    BiTreeNode *child = delete_rec(map, cmp < 0 ? node->left : node->right, key, prefix, removed);
+    if (!*removed) {
+        return node;
+    }
+    node = cow(map, node);
+    if (cmp < 0) {
+        node->left = child;
+    } else {
+        node->right = child;
+    }
+    return rebalance(map, node);
+}
+
+// Free retired nodes that every pinned reader and live version is known
+// to be past. Called with write_lock held.
+static void reclaim(BiTreeSync *map) {
+    uint64_t oldest = map->versions != NULL ? map->versions->epoch : UINT64_MAX;
+    for (int i = 0; i < BITREE_SYNC_MAX_READERS; i++) {
+        uint64_t pinned = atomic_load(&map->readers[i].epoch);
+        if (pinned != 0 && pinned < oldest) {
+            oldest = pinned;
+        }
+    }
+
+    // A reader pinned at epoch e may hold nodes retired at e or later
+    size_t i = map->retired_head;
+    for (; i < map->retired_count && map->retired[i].epoch < oldest; i++) {
+        release_node(map->retired[i].node);
+    }
+    map->retired_head = i;
+    if (map->retired_head == map->retired_count) {
+        map->retired_head = map->retired_count = 0;
+    } else if (map->retired_head > map->retired_count / 2) {
+        map->retired_count -= map->retired_head;
+        memmove(map->retired, map->retired + map->retired_head, map->retired_count * sizeof(Retired));
+        map->retired_head = 0;
+    }
+}
+
+// Make the write visible: seal the private nodes, swap the root, stamp the
+// retired nodes with the epoch they were last reachable in, advance it
+static void publish(BiTreeSync *map, BiTreeNode *root, size_t first_retired) {
+    for (size_t i = 0; i < map->fresh_count; i++) {
+        map->fresh[i]->flags &= ~BITREE_NODE_FRESH;
+    }
+    map->fresh_count = 0;
+
+    atomic_store(&map->root, root);
+    uint64_t epoch = atomic_fetch_add(&map->epoch, 1);
+    for (size_t i = first_retired; i < map->retired_count; i++) {
+        map->retired[i].epoch = epoch;
+    }
+    reclaim(map);
+}
+
+BiTreeSync* BiTreeSync_new(void) {
+    BiTreeSync *map = calloc(1, sizeof(BiTreeSync));
+    if (map == NULL) {
+        fprintf(stderr, "Failed to create a new BiTreeSync\n");
+        return NULL;
+    }
+    atomic_init(&map->root, NULL);
+    atomic_init(&map->epoch, 1);
+    atomic_init(&map->count, 0);
+    pthread_mutex_init(&map->write_lock, NULL);
+    for (int i = 0; i < BITREE_SYNC_MAX_READERS; i++) {
+        atomic_init(&map->readers[i].epoch, 0);
+        atomic_init(&map->readers[i].used, false);
+        map->readers[i].map = map;
+    }
+    return map;
+}
+
+// Destroy the map. No reader may be pinned, no version held and no writer
+// active.
+void BiTreeSync_destroy(BiTreeSync *map) {
+    if (map == NULL) {
+        return;
+    }
+    BiTree_free(atomic_load(&map->root));
+    for (size_t i = map->retired_head; i < map->retired_count; i++) {
+        release_node(map->retired[i].node);
+    }
+    free(map->retired);
+    free(map->fresh);
+    pthread_mutex_destroy(&map->write_lock);
+    free(map);
+}
+
+bool BiTreeSync_insert(BiTreeSync *map, const char *key) {
+    if (map == NULL || key == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&map->write_lock);
+    size_t first_retired = map->retired_count;
+    bool inserted = false;
+    BiTreeNode *root = insert_rec(map, atomic_load(&map->root), key, key_prefix(key), &inserted);
+    if (inserted) {
+        publish(map, root, first_retired);
+        atomic_fetch_add(&map->count, 1);
+    }
+    pthread_mutex_unlock(&map->write_lock);
+    return inserted;
+}
+
+bool BiTreeSync_delete(BiTreeSync *map, const char *key) {
+    if (map == NULL || key == NULL) {
+        return false;
+    }
+    pthread_mutex_lock(&map->write_lock);
+    size_t first_retired = map->retired_count;
+    bool removed = false;
+    BiTreeNode *root = delete_rec(map, atomic_load(&map->root), key, key_prefix(key), &removed);
+    if (removed) {
+        publish(map, root, first_retired);
+        atomic_fetch_sub(&map->count, 1);
+    }
+    pthread_mutex_unlock(&map->write_lock);
+    return removed;
+}
+
+size_t BiTreeSync_size(BiTreeSync *map) {
+    return map == NULL ? 0 : atomic_load(&map->count);
+}
+
+// Claim a reader slot for the calling thread, or NULL if all are taken
+BiTreeSyncReader* BiTreeSync_reader(BiTreeSync *map) {
+    if (map == NULL) {
+        return NULL;
+    }
+    for (int i = 0; i < BITREE_SYNC_MAX_READERS; i++) {
+        bool expected = false;
+        if (atomic_compare_exchange_strong(&map->readers[i].used, &expected, true)) {
+            return &map->readers[i];
+        }
+    }
+    fprintf(stderr, "All %d BiTreeSync reader slots are in use\n", BITREE_SYNC_MAX_READERS);
+    return NULL;
+}
+
+void BiTreeSync_readerRelease(BiTreeSyncReader *reader) {
+    if (reader != NULL) {
+        atomic_store(&reader->epoch, 0);
+        atomic_store(&reader->used, false);
+    }
+}
+
+BiTreeNode* BiTreeSync_pin(BiTreeSyncReader *reader) {
+    // Announce the epoch before loading the root. Both are sequentially
+    // consistent: a writer that misses this announcement in reclaim() has
+    // already published the root this load will see.
+    atomic_store(&reader->epoch, atomic_load(&reader->map->epoch));
+    return atomic_load(&reader->map->root);
+}
+
+void BiTreeSync_unpin(BiTreeSyncReader *reader) {
+    atomic_store_explicit(&reader->epoch, 0, memory_order_release);
+}
+
+bool BiTreeSync_contains(BiTreeSyncReader *reader, const char *key) {
+    bool found = BiTree_find(BiTreeSync_pin(reader), key) != NULL;
+    BiTreeSync_unpin(reader);
+    return found;
+}
+
+// Visit [lo, hi] in order on one consistent version of the map. The visit
+// callback runs pinned, so a long scan holds back reclamation meanwhile.
+size_t BiTreeSync_range(BiTreeSyncReader *reader, const char *lo, const char *hi, BiTree_visit visit, void *ctx) {
+    size_t visited = BiTree_range(BiTreeSync_pin(reader), lo, hi, visit, ctx);
+    BiTreeSync_unpin(reader);
+    return visited;
+}
+
+// Take a snapshot of the current version in O(1). Writers carry on making
+// new versions; the nodes of this one stay valid and unchanged until its
+// last reference is released.
+BiTreeSyncVersion* BiTreeSync_snapshot(BiTreeSync *map) {
+    if (map == NULL) {
+        return NULL;
+    }
+    BiTreeSyncVersion *version = malloc(sizeof(BiTreeSyncVersion));
+    if (version == NULL) {
+        fprintf(stderr, "Failed to create a BiTreeSync version\n");
+        return NULL;
+    }
+    atomic_init(&version->refs, 1);
+    version->map = map;
+    version->next = NULL;
+
+    // With the write lock held no root is being published, so the root,
+    // count and epoch read here belong together
+    pthread_mutex_lock(&map->write_lock);
+    version->root = atomic_load(&map->root);
+    version->count = atomic_load(&map->count);
+    version->epoch = atomic_load(&map->epoch);
+    version->prev = map->versions_tail;
+    if (map->versions_tail != NULL) {
+        map->versions_tail->next = version;
+    } else {
+        map->versions = version;
+    }
+    map->versions_tail = version;
+    pthread_mutex_unlock(&map->write_lock);
+    return version;
+}
+
+// Add a reference, e.g. to hand the version to another thread
+BiTreeSyncVersion* BiTreeSync_versionAcquire(BiTreeSyncVersion *version) {
+    if (version != NULL) {
+        atomic_fetch_add(&version->refs, 1);
+    }
+    return version;
+}
+
+// Drop a reference. The last one unlinks the version and frees the nodes
+// only it still kept alive.
+void BiTreeSync_versionRelease(BiTreeSyncVersion *version) {
+    if (version == NULL || atomic_fetch_sub(&version->refs, 1) != 1) {
+        return;
+    }
+    BiTreeSync *map = version->map;
+    pthread_mutex_lock(&map->write_lock);
+    if (version->prev != NULL) {
+        version->prev->next = version->next;
+    } else {
+        map->versions = version->next;
+    }
+    if (version->next != NULL) {
+        version->next->prev = version->prev;
+    } else {
+        map->versions_tail = version->prev;
+    }
+    reclaim(map);
+    pthread_mutex_unlock(&map->write_lock);
+    free(version);
+}
+
+// Root of the version; any read-only BiTree call may be used on it
+BiTreeNode* BiTreeSync_versionRoot(const BiTreeSyncVersion *version) {
+    return version == NULL ? NULL : version->root;
+}
+
+size_t BiTreeSync_versionSize(const BiTreeSyncVersion *version) {
+    return version == NULL ? 0 : version->count;
+}
+
+// Write the version as a binary snapshot (see BiTree_saveSnapshot) while
+// writers keep going
+bool BiTreeSync_saveVersion(const BiTreeSyncVersion *version, const char *path) {
+    if (version == NULL) {
+        return false;
+    }
+    BiTree tree = { .root = version->root, .node_count = version->count };
+    return BiTree_saveSnapshot(&tree, path);
+}
@@ -0,0 +1,598 @@
+#include "btree.h"
+#include "key_prefix.h"
+
+// Compare a search key against entry i of node, resolving on the cached
+// prefix and only touching the key bytes when the prefixes tie
+static int key_cmp(const BTreeNode *node, int i, uint64_t prefix, const char *key) {
+    if (prefix != node->prefix[i]) {
+        return prefix < node->prefix[i] ? -1 : 1;
+    }
+    if ((prefix & 0xff) == 0) {
+        return 0; // Both keys end inside the prefix
+    }
+    return strcmp(key + 8, node->keys[i] + 8);
+}
+
+// Index of the first entry >= key
+static int lower_bound(const BTreeNode *node, uint64_t prefix, const char *key) {
+    int lo = 0, hi = node->nkeys;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (key_cmp(node, mid, prefix, key) > 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Index of the first entry > key, i.e. the child to descend into
+static int upper_bound(const BTreeNode *node, uint64_t prefix, const char *key) {
+    int lo = 0, hi = node->nkeys;
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (key_cmp(node, mid, prefix, key) >= 0) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+// Node allocation failures leave a half-split tree behind, so they are
+// fatal like the queue/stack allocations in bitree.c
+static BTreeNode* node_new(bool leaf) {
+    BTreeNode *node = malloc(sizeof(BTreeNode));
+    if (node == NULL) {
+        fprintf(stderr, "Memory allocation failed for B-tree node.\n");
+        exit(EXIT_FAILURE);
+    }
+    node->nkeys = 0;
+    node->leaf = leaf;
+    if (leaf) {
+        node->link.prev = NULL;
+        node->link.next = NULL;
+    }
+    return node;
+}
+
+// Open a gap at index i of the key arrays
+static void keys_insert(BTreeNode *node, int i, char *key, uint64_t prefix) {
+    memmove(&node->keys[i + 1], &node->keys[i], (node->nkeys - i) * sizeof(char *));
+    memmove(&node->prefix[i + 1], &node->prefix[i], (node->nkeys - i) * sizeof(uint64_t));
+    node->keys[i] = key;
+    node->prefix[i] = prefix;
+    node->nkeys++;
+}
+
+// Close the gap left by removing entry i of the key arrays
+static void keys_remove(BTreeNode *node, int i) {
+    memmove(&node->keys[i], &node->keys[i + 1], (node->nkeys - i - 1) * sizeof(char *));
+    memmove(&node->prefix[i], &node->prefix[i + 1], (node->nkeys - i - 1) * sizeof(uint64_t));
+    node->nkeys--;
+}
+
+// Copy count entries of src starting at index from into dst at index to
+static void keys_copy(BTreeNode *dst, int to, const BTreeNode *src, int from, int count) {
+    memcpy(&dst->keys[to], &src->keys[from], count * sizeof(char *));
+    memcpy(&dst->prefix[to], &src->prefix[from], count * sizeof(uint64_t));
+}
+
+BTree* BTree_new(void) {
+    BTree *tree = malloc(sizeof(BTree));
+    if (tree == NULL) {
+        fprintf(stderr, "Failed to create a new BTree\n");
+        return NULL;
+    }
+    tree->root = node_new(true);
+    tree->first = tree->root;
+    tree->count = 0;
+    tree->height = 1;
+    return tree;
+}
+
+// Split a full leaf while inserting key at index pos. The new right sibling
+// is returned through *right and its first key is copied as the separator.
+static bool leaf_split(BTreeNode *leaf, int pos, char *key, uint64_t prefix,
+                       char **sep, uint64_t *sep_prefix, BTreeNode **right) {
+    // Stage the ORDER + 1 entries, then deal them out to both halves
+    char *keys[BTREE_ORDER + 1];
+    uint64_t prefixes[BTREE_ORDER + 1];
+    memcpy(keys, leaf->keys, pos * sizeof(char *));
+    memcpy(prefixes, leaf->prefix, pos * sizeof(uint64_t));
+    keys[pos] = key;
+    prefixes[pos] = prefix;
+    memcpy(&keys[pos + 1], &leaf->keys[pos], (BTREE_ORDER - pos) * sizeof(char *));
+    memcpy(&prefixes[pos + 1], &leaf->prefix[pos], (BTREE_ORDER - pos) * sizeof(uint64_t));
+
+    int left_count = (BTREE_ORDER + 1) / 2;
+    int right_count = BTREE_ORDER + 1 - left_count;
+    *sep = strdup(keys[left_count]);
+    if (*sep == NULL) {
+        return false;
+    }
+    *sep_prefix = prefixes[left_count];
+
+    BTreeNode *sibling = node_new(true);
+    memcpy(leaf->keys, keys, left_count * sizeof(char *));
+    memcpy(leaf->prefix, prefixes, left_count * sizeof(uint64_t));
+    memcpy(sibling->keys, &keys[left_count], right_count * sizeof(char *));
+    memcpy(sibling->prefix, &prefixes[left_count], right_count * sizeof(uint64_t));
+    leaf->nkeys = left_count;
+    sibling->nkeys = right_count;
+
+    // Thread the new leaf into the ordered leaf list
+    sibling->link.prev = leaf;
+    sibling->link.next = leaf->link.next;
+    if (leaf->link.next != NULL) {
+        leaf->link.next->link.prev = sibling;
+    }
+    leaf->link.next = sibling;
+    *right = sibling;
+    return true;
+}
+
+// Split a full inner node while inserting separator key and its right child
+// at index pos. The middle separator moves up through *sep.
+static void inner_split(BTreeNode *node, int pos, char *key, uint64_t prefix, BTreeNode *child,
+                        char **sep, uint64_t *sep_prefix, BTreeNode **right) {
+    BTreeNode *sibling = node_new(false);
+
+    char *keys[BTREE_ORDER + 1];
+    uint64_t prefixes[BTREE_ORDER + 1];
+    BTreeNode *children[BTREE_ORDER + 2];
+    memcpy(keys, node->keys, pos * sizeof(char *));
+    memcpy(prefixes, node->prefix, pos * sizeof(uint64_t));
+    keys[pos] = key;
+    prefixes[pos] = prefix;
+    memcpy(&keys[pos + 1], &node->keys[pos], (BTREE_ORDER - pos) * sizeof(char *));
+    memcpy(&prefixes[pos + 1], &node->prefix[pos], (BTREE_ORDER - pos) * sizeof(uint64_t));
+    memcpy(children, node->children, (pos + 1) * sizeof(BTreeNode *));
+    children[pos + 1] = child;
+    memcpy(&children[pos + 2], &node->children[pos + 1], (BTREE_ORDER - pos) * sizeof(BTreeNode *));
+
+    int left_count = BTREE_ORDER / 2;
+    int right_count = BTREE_ORDER - left_count;
+    memcpy(node->keys, keys, left_count * sizeof(char *));
+    memcpy(node->prefix, prefixes, left_count * sizeof(uint64_t));
+    memcpy(node->children, children, (left_count + 1) * sizeof(BTreeNode *));
+    memcpy(sibling->keys, &keys[left_count + 1], right_count * sizeof(char *));
+    memcpy(sibling->prefix, &prefixes[left_count + 1], right_count * sizeof(uint64_t));
+    memcpy(sibling->children, &children[left_count + 1], (right_count + 1) * sizeof(BTreeNode *));
+    node->nkeys = left_count;
+    sibling->nkeys = right_count;
+
+    *sep = keys[left_count];
+    *sep_prefix = prefixes[left_count];
+    *right = sibling;
+}
+
+// Recursive insert. Returns 1 if inserted, 0 for a duplicate, -1 when out of
+// memory. A split of node is reported through *right (else left NULL).
+static int insert_rec(BTreeNode *node, const char *key, uint64_t prefix,
+                      char **sep, uint64_t *sep_prefix, BTreeNode **right) {
+    *right = NULL;
+
+    if (node->leaf) {
+        int pos = lower_bound(node, prefix, key);
+        if (pos < node->nkeys && key_cmp(node, pos, prefix, key) == 0) {
+            return 0;
+        }
+        char *copy = strdup(key);
+        if (copy == NULL) {
+            return -1;
+        }
+        if (node->nkeys < BTREE_ORDER) {
+            keys_insert(node, pos, copy, prefix);
+            return 1;
+        }
+        if (!leaf_split(node, pos, copy, prefix, sep, sep_prefix, right)) {
+            free(copy);
+            return -1;
+        }
+        return 1;
+    }
+
+    int pos = upper_bound(node, prefix, key);
+    char *child_sep;
+    uint64_t child_sep_prefix;
+    BTreeNode *child_right;
+    int status = insert_rec(node->children[pos], key, prefix, &child_sep, &child_sep_prefix, &child_right);
+    if (status <= 0 || child_right == NULL) {
+        return status;
+    }
+
+    if (node->nkeys < BTREE_ORDER) {
+        memmove(&node->children[pos + 2], &node->children[pos + 1], (node->nkeys - pos) * sizeof(BTreeNode *));
+        node->children[pos + 1] = child_right;
+        keys_insert(node, pos, child_sep, child_sep_prefix);
+        return 1;
+    }
+    inner_split(node, pos, child_sep, child_sep_prefix, child_right, sep, sep_prefix, right);
+    return 1;
+}
+
+bool BTree_insert(BTree *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+
+    char *sep;
+    uint64_t sep_prefix;
+    BTreeNode *right;
+    int status = insert_rec(tree->root, key, key_prefix(key), &sep, &sep_prefix, &right);
+    if (status <= 0) {
+        return false;
+    }
+    tree->count++;
+
+    if (right != NULL) {
+        // The root split: grow the tree by one level
+        BTreeNode *root = node_new(false);
+        root->keys[0] = sep;
+        root->prefix[0] = sep_prefix;
+        root->children[0] = tree->root;
+        root->children[1] = right;
+        root->nkeys = 1;
+        tree->root = root;
+        tree->height++;
+    }
+    return true;
+}
+
+// Refill children[i] of parent, which dropped below BTREE_MIN_KEYS, by
+// borrowing from a sibling or merging with one
+static void fix_underflow(BTreeNode *parent, int i) {
+    BTreeNode *child = parent->children[i];
+    BTreeNode *left = i > 0 ? parent->children[i - 1] : NULL;
+    BTreeNode *right = i < parent->nkeys ? parent->children[i + 1] : NULL;
+
+    if (left != NULL && left->nkeys > BTREE_MIN_KEYS) {
+        // Borrow the last entry of the left sibling
+        if (child->leaf) {
+            // The borrowed key becomes the separator, so copy it before
+            // moving anything; on failure the child stays underfull, which
+            // searches tolerate, and the next delete from it tries again
+            char *sep = strdup(left->keys[left->nkeys - 1]);
+            if (sep == NULL) {
+                fprintf(stderr, "Memory allocation failed for B-tree separator.\n");
+                return;
+            }
+            keys_insert(child, 0, left->keys[left->nkeys - 1], left->prefix[left->nkeys - 1]);
+            left->nkeys--;
+            free(parent->keys[i - 1]);
+            parent->keys[i - 1] = sep;
+            parent->prefix[i - 1] = child->prefix[0];
+        } else {
+            memmove(&child->children[1], &child->children[0], (child->nkeys + 1) * sizeof(BTreeNode *));
+            child->children[0] = left->children[left->nkeys];
+            keys_insert(child, 0, parent->keys[i - 1], parent->prefix[i - 1]);
+            parent->keys[i - 1] = left->keys[left->nkeys - 1];
+            parent->prefix[i - 1] = left->prefix[left->nkeys - 1];
+            left->nkeys--;
+        }
+        return;
+    }
+
+    if (right != NULL && right->nkeys > BTREE_MIN_KEYS) {
+        // Borrow the first entry of the right sibling
+        if (child->leaf) {
+            // Same as above: the right sibling's second key is the new separator
+            char *sep = strdup(right->keys[1]);
+            if (sep == NULL) {
+                fprintf(stderr, "Memory allocation failed for B-tree separator.\n");
+                return;
+            }
+            keys_insert(child, child->nkeys, right->keys[0], right->prefix[0]);
+            keys_remove(right, 0);
+            free(parent->keys[i]);
+            parent->keys[i] = sep;
+            parent->prefix[i] = right->prefix[0];
+        } else {
+            child->children[child->nkeys + 1] = right->children[0];
+            keys_insert(child, child->nkeys, parent->keys[i], parent->prefix[i]);
+            parent->keys[i] = right->keys[0];
+            parent->prefix[i] = right->prefix[0];
+            memmove(&right->children[0], &right->children[1], right->nkeys * sizeof(BTreeNode *));
+            keys_remove(right, 0);
+        }
+        return;
+    }
+
+    // Merge with a sibling: always fold children[s + 1] into children[s]
+    int s = left != NULL ? i - 1 : i;
+    BTreeNode *dst = parent->children[s];
+    BTreeNode *src = parent->children[s + 1];
+    if (dst->leaf) {
+        keys_copy(dst, dst->nkeys, src, 0, src->nkeys);
+        dst->nkeys += src->nkeys;
+        dst->link.next = src->link.next;
+        if (src->link.next != NULL) {
+            src->link.next->link.prev = dst;
+        }
+        free(parent->keys[s]);
+    } else {
+        dst->keys[dst->nkeys] = parent->keys[s];
+        dst->prefix[dst->nkeys] = parent->prefix[s];
+        keys_copy(dst, dst->nkeys + 1, src, 0, src->nkeys);
+        memcpy(&dst->children[dst->nkeys + 1], src->children, (src->nkeys + 1) * sizeof(BTreeNode *));
+        dst->nkeys += src->nkeys + 1;
+    }
+    free(src);
+    memmove(&parent->children[s + 1], &parent->children[s + 2], (parent->nkeys - s - 1) * sizeof(BTreeNode *));
+    keys_remove(parent, s);
+}
+
+// Recursive delete, returns true if the key was found and removed
+static bool delete_rec(BTreeNode *node, const char *key, uint64_t prefix) {
+    if (node->leaf) {
+        int pos = lower_bound(node, prefix, key);
+        if (pos == node->nkeys || key_cmp(node, pos, prefix, key) != 0) {
+            return false;
+        }
+        free(node->keys[pos]);
+        keys_remove(node, pos);
+        return true;
+    }
+
+    int pos = upper_bound(node, prefix, key);
+    if (!delete_rec(node->children[pos], key, prefix)) {
+        return false;
+    }
+    if (node->children[pos]->nkeys < BTREE_MIN_KEYS) {
+        fix_underflow(node, pos);
+    }
+    return true;
+}
+
+bool BTree_delete(BTree *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    if (!delete_rec(tree->root, key, key_prefix(key))) {
+        return false;
+    }
+    tree->count--;
+
+    // Shrink the tree when the root is left with a single child
+    if (!tree->root->leaf && tree->root->nkeys == 0) {
+        BTreeNode *old = tree->root;
+        tree->root = old->children[0];
+        tree->height--;
+        free(old);
+    }
+    return true;
+}
+
+// Descend to the leaf that holds key, or would hold it
+static const BTreeNode* find_leaf(const BTree *tree, uint64_t prefix, const char *key) {
+    const BTreeNode *node = tree->root;
+    while (!node->leaf) {
+        node = node->children[upper_bound(node, prefix, key)];
+    }
+    return node;
+}
+
+// Returns the stored copy of key, or NULL if it is not in the tree
+const char* BTree_search(const BTree *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return NULL;
+    }
+    uint64_t prefix = key_prefix(key);
+    const BTreeNode *leaf = find_leaf(tree, prefix, key);
+    int pos = lower_bound(leaf, prefix, key);
+    if (pos < leaf->nkeys && key_cmp(leaf, pos, prefix, key) == 0) {
+        return leaf->keys[pos];
+    }
+    return NULL;
+}
+
+// Visit keys in [lo, hi] in order along the leaf chain. A NULL bound is
+// open. Returns the number of keys visited.
+size_t BTree_scan(const BTree *tree, const char *lo, const char *hi, BTree_visit visit, void *ctx) {
+    if (tree == NULL || visit == NULL) {
+        return 0;
+    }
+
+    const BTreeNode *leaf = tree->first;
+    int pos = 0;
+    if (lo != NULL) {
+        uint64_t prefix = key_prefix(lo);
+        leaf = find_leaf(tree, prefix, lo);
+        pos = lower_bound(leaf, prefix, lo);
+    }
+
+    uint64_t hi_prefix = hi != NULL ? key_prefix(hi) : 0;
+    size_t visited = 0;
+    while (leaf != NULL) {
+        for (; pos < leaf->nkeys; pos++) {
+            if (hi != NULL && key_cmp(leaf, pos, hi_prefix, hi) < 0) {
+                return visited;
+            }
+            visited++;
+            if (!visit(leaf->keys[pos], ctx)) {
+                return visited;
+            }
+        }
+        leaf = leaf->link.next;
+        pos = 0;
+    }
+    return visited;
+}
+
+int BTree_depth(const BTree *tree) {
+    return tree == NULL ? 0 : tree->height;
+}
+
+// Write the keys in order, one "<length> <key>" record per line, after a
+// header line holding the key count
+void BTree_serialize(FILE *fp, const BTree *tree) {
+    if (fp == NULL || tree == NULL) {
+        return;
+    }
+    fprintf(fp, "btree %zu\n", tree->count);
+    for (const BTreeNode *leaf = tree->first; leaf != NULL; leaf = leaf->link.next) {
+        for (int i = 0; i < leaf->nkeys; i++) {
+            fprintf(fp, "%zu %s\n", strlen(leaf->keys[i]), leaf->keys[i]);
+        }
+    }
+}
+
+// Number of the count entries that go to node index when they are spread
+// evenly over nodes
+static size_t node_share(size_t count, size_t nodes, size_t index) {
+    return count / nodes + (index < count % nodes ? 1 : 0);
+}
+
+// Build a packed tree bottom-up from count strictly increasing keys. The
+// keys array is consumed: ownership of every string passes to the tree.
+static bool bulk_load(BTree *tree, char **keys, size_t count) {
+    size_t nleaves = count == 0 ? 1 : (count + BTREE_ORDER - 1) / BTREE_ORDER;
+    BTreeNode **level = malloc(nleaves * sizeof(BTreeNode *));
+    const char **mins = malloc(nleaves * sizeof(char *));
+    if (level == NULL || mins == NULL) {
+        free(level);
+        free(mins);
+        return false;
+    }
+
+    BTreeNode *prev = NULL;
+    size_t next = 0;
+    for (size_t i = 0; i < nleaves; i++) {
+        BTreeNode *leaf = node_new(true);
+        size_t share = node_share(count, nleaves, i);
+        for (size_t k = 0; k < share; k++, next++) {
+            leaf->keys[k] = keys[next];
+            leaf->prefix[k] = key_prefix(keys[next]);
+        }
+        leaf->nkeys = (int)share;
+        leaf->link.prev = prev;
+        if (prev != NULL) {
+            prev->link.next = leaf;
+        } else {
+            tree->first = leaf;
+        }
+        level[i] = leaf;
+        prev = leaf;
+        mins[i] = share > 0 ? leaf->keys[0] : NULL;
+    }
+
+    tree->height = 1;
+    size_t n = nleaves;
+    while (n > 1) {
+        // Each parent takes between BTREE_MIN_KEYS + 1 and BTREE_ORDER + 1 children
+        size_t parents = (n + BTREE_ORDER) / (BTREE_ORDER + 1);
+        size_t child = 0;
+        for (size_t i = 0; i < parents; i++) {
+            BTreeNode *node = node_new(false);
+            size_t share = node_share(n, parents, i);
+            const char *min = mins[child];
+            node->nkeys = 0;
+            node->children[0] = level[child++];
+            for (size_t k = 1; k < share; k++, child++) {
+                // Separators are private copies; leaf keys may be deleted later
+                char *sep = strdup(mins[child]);
+                if (sep == NULL) {
+                    fprintf(stderr, "Memory allocation failed for B-tree separator.\n");
+                    exit(EXIT_FAILURE);
+                }
+                node->keys[k - 1] = sep;
+                node->prefix[k - 1] = key_prefix(sep);
+                node->children[k] = level[child];
+                node->nkeys++;
+            }
+            level[i] = node;
+            mins[i] = min;
+        }
+        n = parents;
+        tree->height++;
+    }
+
+    tree->root = level[0];
+    tree->count = count;
+    free(level);
+    free(mins);
+    return true;
+}
+
+static void free_node(BTreeNode *node) {
+    if (!node->leaf) {
+        for (int i = 0; i <= node->nkeys; i++) {
+            free_node(node->children[i]);
+        }
+    }
+    for (int i = 0; i < node->nkeys; i++) {
+        free(node->keys[i]);
+    }
+    free(node);
+}
+
+// Read back the output of BTree_serialize. Sorted input is bulk loaded
+// into packed leaves; anything else falls back to one insert per key.
+BTree* BTree_deserialize(FILE *fp) {
+    if (fp == NULL) {
+        fprintf(stderr, "File pointer is NULL.\n");
+        return NULL;
+    }
+
+    size_t count;
+    if (fscanf(fp, "btree %zu", &count) != 1) {
+        fprintf(stderr, "Not a serialized BTree.\n");
+        return NULL;
+    }
+
+    char **keys = malloc((count > 0 ? count : 1) * sizeof(char *));
+    if (keys == NULL) {
+        return NULL;
+    }
+    size_t loaded = 0;
+    bool sorted = true;
+    for (; loaded < count; loaded++) {
+        size_t len;
+        if (fscanf(fp, "%zu", &len) != 1 || fgetc(fp) != ' ') {
+            break;
+        }
+        char *key = malloc(len + 1);
+        if (key == NULL || fread(key, 1, len, fp) != len) {
+            free(key);
+            break;
+        }
+        key[len] = '\0';
+        keys[loaded] = key;
+        if (loaded > 0 && strcmp(keys[loaded - 1], key) >= 0) {
+            sorted = false;
+        }
+    }
+
+    BTree *tree = NULL;
+    if (loaded == count) {
+        tree = sorted ? malloc(sizeof(BTree)) : NULL;
+        if (tree != NULL && bulk_load(tree, keys, count)) {
+            free(keys);
+            return tree;
+        }
+        free(tree);
+        tree = BTree_new();
+        for (size_t i = 0; tree != NULL && i < count; i++) {
+            BTree_insert(tree, keys[i]);
+        }
+    } else {
+        fprintf(stderr, "Truncated BTree stream: %zu of %zu keys.\n", loaded, count);
+    }
+
+    for (size_t i = 0; i < loaded; i++) {
+        free(keys[i]);
+    }
+    free(keys);
+    return tree;
+}
+
+void BTree_destroy(BTree *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    free_node(tree->root);
+    free(tree);
+}
@@ -0,0 +1,19 @@
+#ifndef KEY_PREFIX_H
+#define KEY_PREFIX_H
+
+// Cached key prefix shared by the BiTree and BTree engines. Not installed.
+
+#include <stdint.h>
+
+// First 8 bytes of key as a big-endian integer, zero padded. Comparing two
+// prefixes orders keys the same way strcmp does, up to ties.
+static inline uint64_t key_prefix(const char *key) {
+    uint64_t prefix = 0;
+    int i = 0;
+    for (; i < 8 && key[i] != '\0'; i++) {
+        prefix = (prefix << 8) | (unsigned char)key[i];
+    }
+    return i == 0 ? 0 : prefix << (8 * (8 - i));
+}
+
+#endif // KEY_PREFIX_H
@@ -1,3 +1,4 @@
+#include <limits.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -5,17 +6,21 @@
 
 // Function to create a new node and insert it into the binary tree
 void insertNode(BiTree *tree, char *data) {
-    BiTree_insertNode(tree->root, data);
+    BiTree_insert(tree, data);
 }
 
 // Function to delete a node from the binary tree
 void deleteNode(BiTree *tree, char *data) {
-    BiTree_deleteNode(tree->root, data);
+    BiTree_delete(tree, data);
 }
 
 // Function to create a new binary tree node
 void createNode(BiTree *tree, char *data) {
-    tree->root = BiTree_createNode(data);
+    if (tree->root != NULL) {
+        fprintf(stderr, "Tree already has a root node\n");
+        return;
+    }
+    BiTree_insert(tree, data);
 }
 
 // Function to perform breadth-first search (BFS) traversal and serialize the tree
@@ -29,6 +34,252 @@ void BFSAndSerialize(BiTree *tree, const char *filename) {
     fclose(fp);
 }
 
+// Function to bulk build a tree from a sorted key file and snapshot it
+int buildSorted(const char *keys_file, const char *snapshot) {
+    BiTree *tree = BiTree_buildSortedFile(keys_file);
+    if (tree == NULL) {
+        return 1;
+    }
+    printf("Built %zu keys, depth %d\n", tree->node_count, BiTree_depth(tree->root));
+    bool ok = BiTree_saveSnapshot(tree, snapshot);
+    BiTree_destroy(tree);
+    return ok ? 0 : 1;
+}
+
+// Function to print the statistics of a tree, one "name value" per line
+void printStats(FILE *out, BiTree *tree) {
+    BiTreeStats stats;
+    bool counted = BiTree_stats(tree, &stats);
+    fprintf(out, "node_count %zu\n", stats.node_count);
+    fprintf(out, "bytes %zu\n", stats.bytes);
+    fprintf(out, "blocks %llu\n", (unsigned long long)stats.blocks);
+    fprintf(out, "height %d\n", stats.height);
+    if (!counted) {
+        fprintf(out, "# operation counters disabled, rebuild with make STATS=1\n");
+        return;
+    }
+    fprintf(out, "node_allocs %llu\n", (unsigned long long)stats.node_allocs);
+    fprintf(out, "node_frees %llu\n", (unsigned long long)stats.node_frees);
+    fprintf(out, "inserts %llu\n", (unsigned long long)stats.inserts);
+    fprintf(out, "deletes %llu\n", (unsigned long long)stats.deletes);
+    fprintf(out, "lookups %llu\n", (unsigned long long)stats.lookups);
+    fprintf(out, "comparisons %llu\n", (unsigned long long)stats.comparisons);
+    fprintf(out, "visited %llu\n", (unsigned long long)stats.visited);
+    for (int i = 0; i < BITREE_STATS_DEPTHS; i++) {
+        if (stats.depths[i] > 0) {
+            fprintf(out, "depth %d %llu\n", i, (unsigned long long)stats.depths[i]);
+        }
+    }
+}
+
+// Function to load a snapshot, look every key up once and dump the tree
+// statistics; the depth histogram then shows how deep each key sits
+int dumpStats(const char *snapshot) {
+    BiTree *tree = BiTree_loadSnapshot(snapshot);
+    if (tree == NULL) {
+        return 1;
+    }
+    BiTreeCursor cursor;
+    BiTree_cursorInit(&cursor, tree->root);
+    for (BiTreeNode *node = BiTree_cursorFirst(&cursor); node != NULL; node = BiTree_cursorNext(&cursor)) {
+        BiTree_lookup(tree, node->data);
+    }
+    printStats(stdout, tree);
+    BiTree_destroy(tree);
+    return 0;
+}
+
+// Function to check a snapshot file without loading it
+int verifySnapshot(const char *snapshot) {
+    if (!BiTree_verifySnapshot(snapshot)) {
+        return 1;
+    }
+    printf("%s: ok\n", snapshot);
+    return 0;
+}
+
+// Print each visited key on its own line of the batch output
+static bool printKey(BiTreeNode *node, void *ctx) {
+    fputs(node->data, ctx);
+    fputc('\n', ctx);
+    return true;
+}
+
+// Function to run one batch command line against the tree. Returns false
+// on an unknown or malformed command.
+bool runCommand(BiTree *tree, char *line, FILE *out) {
+    char *arg = strchr(line, ' ');
+    if (arg != NULL) {
+        *arg++ = '\0';
+    }
+    const char *command = line;
+
+    if (strcmp(command, "insert") == 0 || strcmp(command, "i") == 0) {
+        if (arg == NULL) {
+            return false;
+        }
+        BiTree_insert(tree, arg);
+    } else if (strcmp(command, "delete") == 0 || strcmp(command, "d") == 0) {
+        if (arg == NULL) {
+            return false;
+        }
+        BiTree_delete(tree, arg);
+    } else if (strcmp(command, "find") == 0 || strcmp(command, "f") == 0) {
+        if (arg == NULL) {
+            return false;
+        }
+        fputs(BiTree_lookup(tree, arg) != NULL ? "1\n" : "0\n", out);
+    } else if (strcmp(command, "get") == 0) {
+        BiTreeValue value;
+        if (arg == NULL) {
+            return false;
+        }
+        if (BiTree_get(tree, arg, &value)) {
+            fprintf(out, "%lld\n", (long long)value.i64);
+        } else {
+            fputc('\n', out);
+        }
+    } else if (strcmp(command, "put") == 0 || strcmp(command, "incr") == 0) {
+        // The number is the last word, so keys may hold spaces as for insert
+        char *number = arg != NULL ? strrchr(arg, ' ') : NULL;
+        if (number == NULL) {
+            return false;
+        }
+        *number++ = '\0';
+        char *end;
+        long long amount = strtoll(number, &end, 10);
+        if (*number == '\0' || *end != '\0') {
+            return false;
+        }
+        BiTreeValue *slot = BiTree_getOrInsert(tree, arg, NULL);
+        if (slot == NULL) {
+            return false;
+        }
+        if (command[0] == 'p') {
+            slot->i64 = amount;
+        } else {
+            slot->i64 += amount;
+            fprintf(out, "%lld\n", (long long)slot->i64);
+        }
+    } else if (strcmp(command, "range") == 0) {
+        char *hi = arg != NULL ? strchr(arg, ' ') : NULL;
+        if (hi == NULL) {
+            return false;
+        }
+        *hi++ = '\0';
+        BiTree_range(tree->root, arg, hi, printKey, out);
+    } else if (strcmp(command, "prefix") == 0) {
+        BiTree_prefixScan(tree->root, arg != NULL ? arg : "", printKey, out);
+    } else if (strcmp(command, "count") == 0) {
+        if (arg == NULL) {
+            fprintf(out, "%zu\n", BiTree_size(tree));
+            return true;
+        }
+        char *hi = strchr(arg, ' ');
+        if (hi == NULL) {
+            return false;
+        }
+        *hi++ = '\0';
+        fprintf(out, "%zu\n", BiTree_countRange(tree->root, arg, hi));
+    } else if (strcmp(command, "rank") == 0) {
+        if (arg == NULL) {
+            return false;
+        }
+        fprintf(out, "%zu\n", BiTree_rank(tree->root, arg));
+    } else if (strcmp(command, "select") == 0) {
+        char *end;
+        size_t k = arg != NULL ? strtoull(arg, &end, 10) : 0;
+        if (arg == NULL || *end != '\0') {
+            return false;
+        }
+        BiTreeNode *node = BiTree_select(tree->root, k);
+        fprintf(out, "%s\n", node != NULL ? node->data : "");
+    } else if (strcmp(command, "stats") == 0) {
+        printStats(out, tree);
+    } else if (strcmp(command, "save") == 0) {
+        return arg != NULL && BiTree_saveSnapshot(tree, arg);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Function to read the next line, of any length, into *line, which grows as
+// needed; getline is not available on every platform. The newline is
+// kept. Returns false at the end of the input.
+static bool readLine(FILE *in, char **line, size_t *capacity, size_t *length) {
+    *length = 0;
+    for (;;) {
+        if (*capacity - *length < 2) {
+            size_t grown = *capacity > 0 ? 2 * *capacity : 256;
+            char *buffer = realloc(*line, grown);
+            if (buffer == NULL) {
+                fprintf(stderr, "Memory allocation failed for batch line.\n");
+                return false;
+            }
+            *line = buffer;
+            *capacity = grown;
+        }
+        size_t room = *capacity - *length;
+        if (fgets(*line + *length, room > INT_MAX ? INT_MAX : (int)room, in) == NULL) {
+            return *length > 0;
+        }
+        *length += strlen(*line + *length);
+        if (*length > 0 && (*line)[*length - 1] == '\n') {
+            return true;
+        }
+    }
+}
+
+// Function to apply newline-delimited commands from a file ("-" for stdin)
+// to one resident tree, optionally loaded from and saved to a snapshot
+int runBatch(const char *commands, const char *load, const char *save) {
+    FILE *in = strcmp(commands, "-") == 0 ? stdin : fopen(commands, "r");
+    if (in == NULL) {
+        fprintf(stderr, "Error opening %s for batch commands\n", commands);
+        return 1;
+    }
+    BiTree *tree = load != NULL ? BiTree_loadSnapshot(load) : BiTree_new(NULL);
+    if (tree == NULL) {
+        if (in != stdin) {
+            fclose(in);
+        }
+        return 1;
+    }
+
+    // Large buffers keep pipelines from paying a syscall per command
+    setvbuf(in, NULL, _IOFBF, 1 << 20);
+    setvbuf(stdout, NULL, _IOFBF, 1 << 20);
+
+    char *line = NULL;
+    size_t capacity = 0;
+    size_t number = 0;
+    size_t errors = 0;
+    size_t length;
+    while (readLine(in, &line, &capacity, &length)) {
+        number++;
+        while (length > 0 && (line[length - 1] == '\n' || line[length - 1] == '\r')) {
+            line[--length] = '\0';
+        }
+        if (length == 0 || line[0] == '#') {
+            continue;
+        }
+        if (!runCommand(tree, line, stdout)) {
+            fprintf(stderr, "%s:%zu: invalid command \"%s\"\n", commands, number, line);
+            errors++;
+        }
+    }
+    free(line);
+    if (in != stdin) {
+        fclose(in);
+    }
+    fflush(stdout);
+
+    bool ok = save == NULL || BiTree_saveSnapshot(tree, save);
+    BiTree_destroy(tree);
+    return ok && errors == 0 ? 0 : 1;
+}
+
 void printUsage() {
     printf("Usage: ./btree [options]\n");
     printf("Options:\n");
@@ -36,6 +287,15 @@ void printUsage() {
     printf("  --delete, -d <data>: Delete a node from the binary tree\n");
     printf("  --create, -c <data>: Create a new binary tree with a root node\n");
     printf("  --bfs, -b <filename>: Perform BFS traversal and serialize the tree to a file\n");
+    printf("  --build, -B <sorted-file> <snapshot>: Bulk build a tree from a sorted key file and save a snapshot\n");
+    printf("  --stats, -s <snapshot>: Load a snapshot, look up every key and print the tree statistics\n");
+    printf("  --verify, -V <snapshot>: Check a snapshot chunk by chunk in bounded memory without loading it\n");
+    printf("  --batch, -x <file|-> [--load <snapshot>] [--save <snapshot>]: Run newline-delimited commands\n");
+    printf("      against one resident tree: insert|i <key>, delete|d <key>, find|f <key> (prints 1/0),\n");
+    printf("      range <lo> <hi>, prefix <p>, count [<lo> <hi>], rank <key>, select <k>, stats,\n");
+    printf("      save <snapshot>, put <key> <n>, get <key> (prints the value, empty if missing),\n");
+    printf("      incr <key> <n> (prints the new value); # starts a comment. Snapshots keep values\n");
+    printf("      in snapshots.\n");
 }
 
 int main(int argc, char *argv[]) {
@@ -44,8 +304,50 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
-    BiTree tree;
-    BiTree_new(&tree);
+    if (strcmp(argv[1], "--build") == 0 || strcmp(argv[1], "-B") == 0) {
+        if (argc != 4) {
+            printf("Invalid arguments. Usage: ./btree --build <sorted-file> <snapshot>\n");
+            return 1;
+        }
+        return buildSorted(argv[2], argv[3]);
+    }
+
+    if (strcmp(argv[1], "--stats") == 0 || strcmp(argv[1], "-s") == 0) {
+        if (argc != 3) {
+            printf("Invalid arguments. Usage: ./btree --stats <snapshot>\n");
+            return 1;
+        }
+        return dumpStats(argv[2]);
+    }
+
+    if (strcmp(argv[1], "--verify") == 0 || strcmp(argv[1], "-V") == 0) {
+        if (argc != 3) {
+            printf("Invalid arguments. Usage: ./btree --verify <snapshot>\n");
+            return 1;
+        }
+        return verifySnapshot(argv[2]);
+    }
+
+    if (strcmp(argv[1], "--batch") == 0 || strcmp(argv[1], "-x") == 0) {
+        const char *load = NULL;
+        const char *save = NULL;
+        for (int i = 3; i < argc; i += 2) {
+            if (i + 1 < argc && strcmp(argv[i], "--load") == 0) {
+                load = argv[i + 1];
+            } else if (i + 1 < argc && strcmp(argv[i], "--save") == 0) {
+                save = argv[i + 1];
+            } else {
+                printf("Invalid arguments. Usage: ./btree --batch <file|-> [--load <snapshot>] [--save <snapshot>]\n");
+                return 1;
+            }
+        }
+        return runBatch(argv[2], load, save);
+    }
+
+    BiTree *tree = BiTree_new(NULL);
+    if (tree == NULL) {
+        return 1;
+    }
 
     if (strcmp(argv[1], "--create") == 0 || strcmp(argv[1], "-c") == 0) {
         if (argc != 3) {
@@ -53,28 +355,28 @@ int main(int argc, char *argv[]) {
             return 1;
         }
         char *data = argv[2];
-        createNode(&tree, data);
+        createNode(tree, data);
     } else if (strcmp(argv[1], "--insert") == 0 || strcmp(argv[1], "-i") == 0) {
         if (argc != 3) {
             printf("Invalid arguments. Usage: ./btree --insert <data>\n");
             return 1;
         }
         char *data = argv[2];
-        insertNode(&tree, data);
+        insertNode(tree, data);
     } else if (strcmp(argv[1], "--bfs") == 0 || strcmp(argv[1], "-b") == 0) {
         if (argc != 3) {
             printf("Invalid arguments. Usage: ./btree --bfs <filename>\n");
             return 1;
         }
         char *filename = argv[2];
-        BFSAndSerialize(&tree, filename);
+        BFSAndSerialize(tree, filename);
     } else {
         printf("Unknown option: %s\n", argv[1]);
         printUsage();
         return 1;
     }
 
-    BiTree_destroy(&tree);
+    BiTree_destroy(tree);
 
     return 0;
 }
@@ -0,0 +1,459 @@
+#include "radix.h"
+#include <stddef.h>
+
+// Child arrays double in size up to one slot per possible byte
+#define RADIX_MAX_CHILDREN 256
+
+// Labels start inside the struct padding; short ones still get a whole struct
+static size_t node_bytes(size_t length) {
+    size_t bytes = offsetof(RadixNode, label) + length;
+    return bytes < sizeof(RadixNode) ? sizeof(RadixNode) : bytes;
+}
+
+static size_t children_bytes(size_t capacity) {
+    return capacity * (sizeof(RadixNode *) + 1);
+}
+
+// First label byte of each child, stored right after the child slots
+static unsigned char* node_edges(const RadixNode *node) {
+    return (unsigned char *)(node->children + node->capacity);
+}
+
+// Allocation failures leave a half-updated tree behind, so they are fatal
+// like the node allocations in btree.c
+static void* radix_alloc(void *block, size_t size) {
+    block = realloc(block, size);
+    if (block == NULL) {
+        fprintf(stderr, "Memory allocation failed for radix node.\n");
+        exit(EXIT_FAILURE);
+    }
+    return block;
+}
+
+static RadixNode* node_new(Radix *tree, const unsigned char *label, size_t length) {
+    RadixNode *node = radix_alloc(NULL, node_bytes(length));
+    node->children = NULL;
+    node->length = (uint32_t)length;
+    node->nchildren = 0;
+    node->capacity = 0;
+    node->terminal = false;
+    memcpy(node->label, label, length);
+    tree->bytes += node_bytes(length);
+    return node;
+}
+
+static void node_free(Radix *tree, RadixNode *node) {
+    tree->bytes -= node_bytes(node->length) + children_bytes(node->capacity);
+    free(node->children);
+    free(node);
+}
+
+// Index of the child whose label starts with byte, or -1
+static int child_index(const RadixNode *node, unsigned char byte) {
+    if (node->nchildren == 0) {
+        return -1;
+    }
+    const unsigned char *edges = node_edges(node);
+    const unsigned char *hit = memchr(edges, byte, node->nchildren);
+    return hit == NULL ? -1 : (int)(hit - edges);
+}
+
+// Insert child at its sorted position, growing the child arrays as needed
+static void child_add(Radix *tree, RadixNode *node, RadixNode *child) {
+    if (node->nchildren == node->capacity) {
+        size_t capacity = node->capacity == 0 ? 2 : 2 * (size_t)node->capacity;
+        if (capacity > RADIX_MAX_CHILDREN) {
+            capacity = RADIX_MAX_CHILDREN;
+        }
+        RadixNode **children = radix_alloc(node->children, children_bytes(capacity));
+        // The edge bytes follow the slots and move up with them
+        memmove(children + capacity, children + node->capacity, node->nchildren);
+        tree->bytes += children_bytes(capacity) - children_bytes(node->capacity);
+        node->children = children;
+        node->capacity = (uint16_t)capacity;
+    }
+    unsigned char *edges = node_edges(node);
+    unsigned char byte = child->label[0];
+    int i = node->nchildren;
+    while (i > 0 && edges[i - 1] > byte) {
+        i--;
+    }
+    memmove(&node->children[i + 1], &node->children[i], (node->nchildren - i) * sizeof(RadixNode *));
+    memmove(&edges[i + 1], &edges[i], node->nchildren - i);
+    node->children[i] = child;
+    edges[i] = byte;
+    node->nchildren++;
+}
+
+// Remove child i; a node left without children gives its arrays back
+static void child_remove(Radix *tree, RadixNode *node, int i) {
+    unsigned char *edges = node_edges(node);
+    memmove(&node->children[i], &node->children[i + 1], (node->nchildren - i - 1) * sizeof(RadixNode *));
+    memmove(&edges[i], &edges[i + 1], node->nchildren - i - 1);
+    if (--node->nchildren == 0) {
+        tree->bytes -= children_bytes(node->capacity);
+        free(node->children);
+        node->children = NULL;
+        node->capacity = 0;
+    }
+}
+
+// Length of the common prefix of two byte strings of at least n bytes,
+// compared a word at a time
+static size_t common_length(const unsigned char *a, const unsigned char *b, size_t n) {
+    size_t i = 0;
+    for (; i + 8 <= n; i += 8) {
+        uint64_t x, y;
+        memcpy(&x, a + i, 8);
+        memcpy(&y, b + i, 8);
+        if (x != y) {
+            break;
+        }
+    }
+    while (i < n && a[i] == b[i]) {
+        i++;
+    }
+    return i;
+}
+
+// Drop the first drop bytes of the label of node, which may move it
+static RadixNode* node_trim(Radix *tree, RadixNode *node, size_t drop) {
+    size_t length = node->length - drop;
+    memmove(node->label, node->label + drop, length);
+    tree->bytes -= node_bytes(node->length) - node_bytes(length);
+    node->length = (uint32_t)length;
+    return radix_alloc(node, node_bytes(length));
+}
+
+// Fold the only child of *slot into it. Keeps every node below the root
+// either a key or a branch after a delete.
+static void node_merge(Radix *tree, RadixNode **slot) {
+    RadixNode *node = *slot;
+    RadixNode *child = node->children[0];
+    size_t length = (size_t)node->length + child->length;
+    RadixNode *merged = radix_alloc(child, node_bytes(length));
+    memmove(merged->label + node->length, merged->label, merged->length);
+    memcpy(merged->label, node->label, node->length);
+    tree->bytes += node_bytes(length) - node_bytes(merged->length);
+    merged->length = (uint32_t)length;
+    *slot = merged;
+    node_free(tree, node);
+}
+
+Radix* Radix_new(void) {
+    Radix *tree = malloc(sizeof(Radix));
+    if (tree == NULL) {
+        fprintf(stderr, "Failed to create a new Radix\n");
+        return NULL;
+    }
+    tree->bytes = 0;
+    tree->count = 0;
+    tree->root = node_new(tree, (const unsigned char *)"", 0);
+    return tree;
+}
+
+// Insert key. Returns false if it is already present.
+bool Radix_insert(Radix *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    const unsigned char *p = (const unsigned char *)key;
+    size_t left = strlen(key);
+    RadixNode **slot = &tree->root;
+    for (;;) {
+        RadixNode *node = *slot;
+        size_t n = node->length < left ? node->length : left;
+        size_t common = common_length(node->label, p, n);
+        if (common < node->length) {
+            // The key leaves the label part way: split it, with a new node
+            // taking the shared bytes
+            RadixNode *parent = node_new(tree, node->label, common);
+            child_add(tree, parent, node_trim(tree, node, common));
+            *slot = parent;
+            node = parent;
+        }
+        p += common;
+        left -= common;
+        if (left == 0) {
+            if (node->terminal) {
+                return false;
+            }
+            node->terminal = true;
+            tree->count++;
+            return true;
+        }
+        int i = child_index(node, *p);
+        if (i < 0) {
+            RadixNode *leaf = node_new(tree, p, left);
+            leaf->terminal = true;
+            child_add(tree, node, leaf);
+            tree->count++;
+            return true;
+        }
+        slot = &node->children[i];
+    }
+}
+
+// Delete key. Returns false if it is not present.
+bool Radix_delete(Radix *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    const unsigned char *p = (const unsigned char *)key;
+    size_t left = strlen(key);
+    RadixNode **parent_slot = NULL;
+    RadixNode **slot = &tree->root;
+    int index = 0;              // of *slot among its parent's children
+    for (;;) {
+        RadixNode *node = *slot;
+        if (node->length > left || memcmp(node->label, p, node->length) != 0) {
+            return false;
+        }
+        p += node->length;
+        left -= node->length;
+        if (left == 0) {
+            break;
+        }
+        int i = child_index(node, *p);
+        if (i < 0) {
+            return false;
+        }
+        parent_slot = slot;
+        index = i;
+        slot = &node->children[i];
+    }
+
+    RadixNode *node = *slot;
+    if (!node->terminal) {
+        return false;
+    }
+    node->terminal = false;
+    tree->count--;
+    if (parent_slot == NULL) {
+        return true; // The root stays, even when empty
+    }
+    if (node->nchildren == 0) {
+        RadixNode *parent = *parent_slot;
+        child_remove(tree, parent, index);
+        node_free(tree, node);
+        // The parent held a key or branched; it may now do neither
+        if (parent_slot != &tree->root && !parent->terminal && parent->nchildren == 1) {
+            node_merge(tree, parent_slot);
+        }
+    } else if (node->nchildren == 1) {
+        node_merge(tree, slot);
+    }
+    return true;
+}
+
+bool Radix_search(const Radix *tree, const char *key) {
+    if (tree == NULL || key == NULL) {
+        return false;
+    }
+    const unsigned char *p = (const unsigned char *)key;
+    size_t left = strlen(key);
+    const RadixNode *node = tree->root;
+    for (;;) {
+        if (node->length > left || memcmp(node->label, p, node->length) != 0) {
+            return false;
+        }
+        p += node->length;
+        left -= node->length;
+        if (left == 0) {
+            return node->terminal;
+        }
+        int i = child_index(node, *p);
+        if (i < 0) {
+            return false;
+        }
+        node = node->children[i];
+    }
+}
+
+// Depth first walk state. Paths can be as deep as the longest key, so the
+// walk keeps its own stack instead of recursing.
+typedef struct {
+    const RadixNode *node;
+    size_t base;                // key bytes above node
+    int next;                   // next child to enter, -1 before node itself
+} ScanFrame;
+
+typedef struct {
+    const char *lo;             // bounds, NULL when open
+    size_t lo_length;
+    const char *hi;
+    size_t hi_length;
+    Radix_visit visit;
+    void *ctx;
+    char *key;                  // bytes of the path being walked
+    size_t capacity;
+    ScanFrame *frames;
+    size_t depth;
+    size_t frame_capacity;
+    size_t visited;
+} RadixScan;
+
+static void scan_push(RadixScan *scan, const RadixNode *node, size_t base) {
+    if (scan->depth == scan->frame_capacity) {
+        scan->frame_capacity = scan->frame_capacity == 0 ? 16 : 2 * scan->frame_capacity;
+        scan->frames = radix_alloc(scan->frames, scan->frame_capacity * sizeof(ScanFrame));
+    }
+    scan->frames[scan->depth++] = (ScanFrame){ node, base, -1 };
+}
+
+// Enter node: append its label to the key, prune it if every key below
+// lies outside [lo, hi], else visit the key ending here. Returns -1 to
+// skip the subtree, 0 to stop the walk and 1 to go on into the children.
+static int scan_enter(RadixScan *scan, const ScanFrame *frame) {
+    const RadixNode *node = frame->node;
+    size_t length = frame->base + node->length;
+    if (length + 1 > scan->capacity) {
+        scan->capacity = 2 * length + 64;
+        scan->key = radix_alloc(scan->key, scan->capacity);
+    }
+    memcpy(scan->key + frame->base, node->label, node->length);
+
+    // Every key below starts with the length bytes built so far
+    bool below_lo = false;
+    if (scan->lo != NULL) {
+        size_t n = length < scan->lo_length ? length : scan->lo_length;
+        int c = memcmp(scan->key, scan->lo, n);
+        if (c < 0) {
+            return -1;
+        }
+        below_lo = c == 0 && length < scan->lo_length;
+    }
+    if (scan->hi != NULL) {
+        size_t n = length < scan->hi_length ? length : scan->hi_length;
+        int c = memcmp(scan->key, scan->hi, n);
+        if (c > 0 || (c == 0 && length > scan->hi_length)) {
+            return 0;
+        }
+    }
+    if (node->terminal && !below_lo) {
+        scan->key[length] = '\0';
+        scan->visited++;
+        if (!scan->visit(scan->key, scan->ctx)) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Walk the subtree at start in key order; base bytes of scan->key are
+// already filled in
+static void scan_run(RadixScan *scan, const RadixNode *start, size_t base) {
+    scan_push(scan, start, base);
+    while (scan->depth > 0) {
+        ScanFrame *frame = &scan->frames[scan->depth - 1];
+        if (frame->next < 0) {
+            int action = scan_enter(scan, frame);
+            if (action == 0) {
+                break;
+            }
+            if (action < 0) {
+                scan->depth--;
+                continue;
+            }
+            frame->next = 0;
+        }
+        const RadixNode *node = frame->node;
+        if (frame->next == node->nchildren) {
+            scan->depth--;
+            continue;
+        }
+        scan_push(scan, node->children[frame->next++], frame->base + node->length);
+    }
+    free(scan->frames);
+    free(scan->key);
+}
+
+// Visit keys in [lo, hi] in order. A NULL bound is open. Returns the number
+// of keys visited.
+size_t Radix_scan(const Radix *tree, const char *lo, const char *hi, Radix_visit visit, void *ctx) {
+    if (tree == NULL || visit == NULL) {
+        return 0;
+    }
+    RadixScan scan = {
+        lo, lo != NULL ? strlen(lo) : 0, hi, hi != NULL ? strlen(hi) : 0,
+        visit, ctx, NULL, 0, NULL, 0, 0, 0
+    };
+    scan_run(&scan, tree->root, 0);
+    return scan.visited;
+}
+
+// Visit every key that starts with prefix, in order. The descent to the
+// subtree holding them reads each prefix byte once.
+size_t Radix_prefixScan(const Radix *tree, const char *prefix, Radix_visit visit, void *ctx) {
+    if (tree == NULL || prefix == NULL || visit == NULL) {
+        return 0;
+    }
+    const unsigned char *p = (const unsigned char *)prefix;
+    size_t left = strlen(prefix);
+    const RadixNode *node = tree->root;
+    for (;;) {
+        size_t n = node->length < left ? node->length : left;
+        if (memcmp(node->label, p, n) != 0) {
+            return 0;
+        }
+        if (left <= node->length) {
+            break; // The prefix ends on the edge into node
+        }
+        p += node->length;
+        left -= node->length;
+        int i = child_index(node, *p);
+        if (i < 0) {
+            return 0;
+        }
+        node = node->children[i];
+    }
+
+    size_t base = (const char *)p - prefix;
+    RadixScan scan = { NULL, 0, NULL, 0, visit, ctx, NULL, 0, NULL, 0, 0, 0 };
+    scan.capacity = base + node->length + 64;
+    scan.key = radix_alloc(NULL, scan.capacity);
+    memcpy(scan.key, prefix, base);
+    scan_run(&scan, node, base);
+    return scan.visited;
+}
+
+// Longest chain of nodes below the root
+int Radix_depth(const Radix *tree) {
+    if (tree == NULL) {
+        return 0;
+    }
+    // Walk with an explicit stack; frame.base holds the depth of the node
+    RadixScan scan = { 0 };
+    scan_push(&scan, tree->root, 0);
+    size_t depth = 0;
+    while (scan.depth > 0) {
+        ScanFrame frame = scan.frames[--scan.depth];
+        if (frame.base > depth) {
+            depth = frame.base;
+        }
+        for (int i = 0; i < frame.node->nchildren; i++) {
+            scan_push(&scan, frame.node->children[i], frame.base + 1);
+        }
+    }
+    free(scan.frames);
+    return (int)depth;
+}
+
+void Radix_destroy(Radix *tree) {
+    if (tree == NULL) {
+        return;
+    }
+    // Detach and free one node at a time, pushing its children
+    RadixScan scan = { 0 };
+    scan_push(&scan, tree->root, 0);
+    while (scan.depth > 0) {
+        RadixNode *node = (RadixNode *)scan.frames[--scan.depth].node;
+        for (int i = 0; i < node->nchildren; i++) {
+            scan_push(&scan, node->children[i], 0);
+        }
+        free(node->children);
+        free(node);
+    }
+    free(scan.frames);
+    free(tree);
+}
@@ -0,0 +1,270 @@
+#include "taskpool.h"
+
+#include <stdio.h>
+#include <pthread.h>
+#include <sched.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+typedef struct {
+    TaskPool_fn fn;
+    void *arg;
+    TaskGroup *group;
+} Task;
+
+// Mutex-guarded ring buffer of tasks
+typedef struct {
+    pthread_mutex_t lock;
+    Task *tasks;
+    size_t head;        // index of the oldest task
+    size_t count;
+    size_t capacity;
+} TaskDeque;
+
+typedef struct {
+    TaskPool *pool;
+    TaskDeque deque;
+    pthread_t thread;
+    unsigned seed;      // victim selection for stealing
+} TaskWorker;
+
+struct TaskPool {
+    TaskWorker *workers;
+    int threads;
+    TaskDeque inject;           // tasks spawned from outside the pool
+    atomic_size_t queued;       // tasks sitting in any deque
+    pthread_mutex_t sleep_lock;
+    pthread_cond_t wake;
+    int sleepers;
+    bool shutdown;
+};
+
+// Worker running on this thread, NULL outside of any pool
+static _Thread_local TaskWorker *current_worker;
+
+static void deque_init(TaskDeque *deque) {
+    pthread_mutex_init(&deque->lock, NULL);
+    deque->tasks = NULL;
+    deque->head = 0;
+    deque->count = 0;
+    deque->capacity = 0;
+}
+
+static void deque_destroy(TaskDeque *deque) {
+    pthread_mutex_destroy(&deque->lock);
+    free(deque->tasks);
+}
+
+static void deque_push(TaskDeque *deque, Task task) {
+    pthread_mutex_lock(&deque->lock);
+    if (deque->count == deque->capacity) {
+        size_t capacity = deque->capacity > 0 ? deque->capacity * 2 : 64;
+        Task *tasks = malloc(capacity * sizeof(Task));
+        if (tasks == NULL) {
+            fprintf(stderr, "Memory allocation failed for task deque.\n");
+            exit(EXIT_FAILURE);
+        }
+        for (size_t i = 0; i < deque->count; i++) {
+            tasks[i] = deque->tasks[(deque->head + i) % deque->capacity];
+        }
+        free(deque->tasks);
+        deque->tasks = tasks;
+        deque->head = 0;
+        deque->capacity = capacity;
+    }
+    deque->tasks[(deque->head + deque->count) % deque->capacity] = task;
+    deque->count++;
+    pthread_mutex_unlock(&deque->lock);
+}
+
+// Take the newest task (owner side) or the oldest one (thief side)
+static bool deque_pop(TaskDeque *deque, bool newest, Task *task) {
+    pthread_mutex_lock(&deque->lock);
+    bool found = deque->count > 0;
+    if (found) {
+        if (newest) {
+            *task = deque->tasks[(deque->head + deque->count - 1) % deque->capacity];
+        } else {
+            *task = deque->tasks[deque->head];
+            deque->head = (deque->head + 1) % deque->capacity;
+        }
+        deque->count--;
+    }
+    pthread_mutex_unlock(&deque->lock);
+    return found;
+}
+
+// Find a task for worker (NULL for a thread outside the pool): its own
+// deque first, then the injection queue, then steal from a random victim
+static bool find_task(TaskPool *pool, TaskWorker *worker, Task *task) {
+    if (atomic_load(&pool->queued) == 0) {
+        return false;
+    }
+    bool found = (worker != NULL && deque_pop(&worker->deque, true, task))
+        || deque_pop(&pool->inject, false, task);
+    if (!found) {
+        unsigned start = worker != NULL ? (worker->seed = worker->seed * 1103515245u + 12345u) >> 16 : 0;
+        for (int i = 0; i < pool->threads && !found; i++) {
+            TaskWorker *victim = &pool->workers[(start + i) % pool->threads];
+            if (victim != worker) {
+                found = deque_pop(&victim->deque, false, task);
+            }
+        }
+    }
+    if (found) {
+        atomic_fetch_sub(&pool->queued, 1);
+    }
+    return found;
+}
+
+static void run_task(Task *task) {
+    task->fn(task->arg);
+    atomic_fetch_sub(&task->group->pending, 1);
+}
+
+static void* worker_main(void *arg) {
+    TaskWorker *worker = arg;
+    TaskPool *pool = worker->pool;
+    current_worker = worker;
+
+    for (;;) {
+        Task task;
+        if (find_task(pool, worker, &task)) {
+            run_task(&task);
+            continue;
+        }
+
+        // Sleep until a spawn bumps the queued count. Spawners signal under
+        // sleep_lock, so checking the count under it cannot miss a wakeup.
+        pthread_mutex_lock(&pool->sleep_lock);
+        if (pool->shutdown) {
+            pthread_mutex_unlock(&pool->sleep_lock);
+            break;
+        }
+        if (atomic_load(&pool->queued) == 0) {
+            pool->sleepers++;
+            pthread_cond_wait(&pool->wake, &pool->sleep_lock);
+            pool->sleepers--;
+        }
+        pthread_mutex_unlock(&pool->sleep_lock);
+    }
+    return NULL;
+}
+
+static int online_cpus(void) {
+#ifdef _WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return (int)info.dwNumberOfProcessors;
+#else
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    return cpus > 0 ? (int)cpus : 1;
+#endif
+}
+
+// Start a pool of threads workers; 0 means one per online CPU
+TaskPool* TaskPool_new(int threads) {
+    if (threads <= 0) {
+        threads = online_cpus();
+    }
+    TaskPool *pool = malloc(sizeof(TaskPool));
+    if (pool == NULL) {
+        fprintf(stderr, "Failed to create a new TaskPool\n");
+        return NULL;
+    }
+    pool->workers = calloc(threads, sizeof(TaskWorker));
+    if (pool->workers == NULL) {
+        fprintf(stderr, "Failed to create a new TaskPool\n");
+        free(pool);
+        return NULL;
+    }
+    pool->threads = threads;
+    deque_init(&pool->inject);
+    atomic_init(&pool->queued, 0);
+    pthread_mutex_init(&pool->sleep_lock, NULL);
+    pthread_cond_init(&pool->wake, NULL);
+    pool->sleepers = 0;
+    pool->shutdown = false;
+
+    for (int i = 0; i < threads; i++) {
+        TaskWorker *worker = &pool->workers[i];
+        worker->pool = pool;
+        worker->seed = (unsigned)i * 2654435761u + 1;
+        deque_init(&worker->deque);
+    }
+    for (int i = 0; i < threads; i++) {
+        if (pthread_create(&pool->workers[i].thread, NULL, worker_main, &pool->workers[i]) != 0) {
+            fprintf(stderr, "Failed to start TaskPool worker %d\n", i);
+            exit(EXIT_FAILURE);
+        }
+    }
+    return pool;
+}
+
+// Stop the workers once they run out of work and free the pool
+void TaskPool_destroy(TaskPool *pool) {
+    if (pool == NULL) {
+        return;
+    }
+    pthread_mutex_lock(&pool->sleep_lock);
+    pool->shutdown = true;
+    pthread_cond_broadcast(&pool->wake);
+    pthread_mutex_unlock(&pool->sleep_lock);
+
+    for (int i = 0; i < pool->threads; i++) {
+        pthread_join(pool->workers[i].thread, NULL);
+        deque_destroy(&pool->workers[i].deque);
+    }
+    deque_destroy(&pool->inject);
+    pthread_mutex_destroy(&pool->sleep_lock);
+    pthread_cond_destroy(&pool->wake);
+    free(pool->workers);
+    free(pool);
+}
+
+int TaskPool_threads(const TaskPool *pool) {
+    return pool == NULL ? 0 : pool->threads;
+}
+
+// Queue fn(arg) as part of group. From a worker of this pool the task goes
+// on that worker's own deque, otherwise on the shared injection queue.
+void TaskPool_spawn(TaskPool *pool, TaskGroup *group, TaskPool_fn fn, void *arg) {
+    Task task = { fn, arg, group };
+    atomic_fetch_add(&group->pending, 1);
+
+    // Count the task before it becomes visible so queued never underflows
+    atomic_fetch_add(&pool->queued, 1);
+    TaskWorker *worker = current_worker;
+    if (worker != NULL && worker->pool == pool) {
+        deque_push(&worker->deque, task);
+    } else {
+        deque_push(&pool->inject, task);
+    }
+
+    pthread_mutex_lock(&pool->sleep_lock);
+    if (pool->sleepers > 0) {
+        pthread_cond_signal(&pool->wake);
+    }
+    pthread_mutex_unlock(&pool->sleep_lock);
+}
+
+// Block until every task of group has finished, running queued tasks
+// (this group's or any other) in the meantime instead of idling
+void TaskPool_wait(TaskPool *pool, TaskGroup *group) {
+    TaskWorker *worker = current_worker;
+    if (worker != NULL && worker->pool != pool) {
+        worker = NULL;
+    }
+    while (atomic_load(&group->pending) > 0) {
+        Task task;
+        if (find_task(pool, worker, &task)) {
+            run_task(&task);
+        } else {
+            sched_yield();
+        }
+    }
+}
@@ -0,0 +1,81 @@
+// Batch inserts and deletes of every shape keep the tree a valid AVL tree
+// with correct heights and subtree sizes, including the lopsided batches
+// that make batch_rebalance rebuild whole subtrees
+#include "bitree.h"
+
+#include <assert.h>
+
+#define KEYS 50000
+
+static char keys[KEYS][16];
+static bool present[KEYS];
+
+// Height of node's subtree, checking order, balance and the cached fields
+static int check_node(const BiTreeNode *node, const char *lo, const char *hi, size_t *count) {
+    if (node == NULL) {
+        return 0;
+    }
+    assert(lo == NULL || strcmp(lo, node->data) < 0);
+    assert(hi == NULL || strcmp(node->data, hi) < 0);
+    size_t before = *count;
+    int left = check_node(node->left, lo, node->data, count);
+    int right = check_node(node->right, node->data, hi, count);
+    (*count)++;
+    assert(left - right >= -1 && left - right <= 1);
+    assert(node->height == 1 + (left > right ? left : right));
+    assert(node->size == *count - before);
+    return node->height;
+}
+
+static void check_tree(BiTree *tree) {
+    size_t count = 0;
+    check_node(tree->root, NULL, NULL, &count);
+    size_t expected = 0;
+    for (int i = 0; i < KEYS; i++) {
+        assert((BiTree_find(tree->root, keys[i]) != NULL) == present[i]);
+        expected += present[i];
+    }
+    assert(count == expected && BiTree_size(tree) == expected);
+}
+
+// Apply keys [from, to) in steps of step as one batch
+static void batch(BiTree *tree, bool insert, int from, int to, int step, bool sorted) {
+    const char **run = malloc(KEYS * sizeof(char *));
+    assert(run != NULL);
+    size_t n = 0;
+    size_t changes = 0;
+    for (int i = from; i < to; i += step) {
+        run[n++] = keys[i];
+        changes += present[i] != insert;
+        present[i] = insert;
+    }
+    size_t done = insert ? BiTree_insertBatch(tree, run, n, sorted) : BiTree_deleteBatch(tree, run, n, sorted);
+    assert(done == changes);
+    free(run);
+    check_tree(tree);
+}
+
+int main(void) {
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(keys[i], sizeof(keys[i]), "%08d", i);
+    }
+    BiTree *tree = BiTree_new(NULL);
+    assert(tree != NULL);
+
+    batch(tree, true, 0, 100, 1, true);
+    // Far more keys than the tree holds, all on its right: a rebuild
+    batch(tree, true, 100, KEYS / 2, 1, true);
+    // Interleaved with what is there, unsorted input
+    batch(tree, true, KEYS / 2, KEYS, 3, false);
+    batch(tree, true, 0, KEYS, 7, false);
+    // Empty out the left half, which leaves the root heavy on the right
+    batch(tree, false, 0, KEYS / 2, 1, true);
+    batch(tree, false, KEYS / 2, KEYS, 2, false);
+    batch(tree, true, 0, KEYS / 4, 1, true);
+    batch(tree, false, 0, KEYS, 1, true);
+    assert(tree->root == NULL);
+
+    BiTree_destroy(tree);
+    printf("batch_update: ok\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+// Deletes that drive BTree leaves through borrows from both siblings and
+// merges; every key left behind must still be found through its separators
+#include "btree.h"
+
+#include <assert.h>
+
+#define KEYS 20000
+
+static void make_key(char *key, size_t size, unsigned i) {
+    snprintf(key, size, "key-%06u", i);
+}
+
+static bool count_key(const char *key, void *ctx) {
+    (void)key;
+    (*(size_t *)ctx)++;
+    return true;
+}
+
+// Every key still in the tree is found and every deleted one is not
+static void check(const BTree *tree, const bool *present) {
+    char key[32];
+    size_t expected = 0;
+    for (unsigned i = 0; i < KEYS; i++) {
+        make_key(key, sizeof(key), i);
+        const char *found = BTree_search(tree, key);
+        assert(present[i] ? found != NULL && strcmp(found, key) == 0 : found == NULL);
+        expected += present[i];
+    }
+    size_t scanned = 0;
+    assert(BTree_scan(tree, NULL, NULL, count_key, &scanned) == expected);
+    assert(scanned == expected && tree->count == expected);
+}
+
+int main(void) {
+    static bool present[KEYS];
+    BTree *tree = BTree_new();
+    assert(tree != NULL);
+    char key[32];
+    for (unsigned i = 0; i < KEYS; i++) {
+        make_key(key, sizeof(key), i);
+        assert(BTree_insert(tree, key));
+        present[i] = true;
+    }
+
+    // Descending deletes borrow from the left, ascending ones from the
+    // right, and a strided pass leaves siblings thin enough to merge
+    unsigned i = KEYS;
+    while (i-- > 3 * KEYS / 4) {
+        make_key(key, sizeof(key), i);
+        assert(BTree_delete(tree, key));
+        present[i] = false;
+    }
+    check(tree, present);
+    for (i = 0; i < KEYS / 4; i++) {
+        make_key(key, sizeof(key), i);
+        assert(BTree_delete(tree, key));
+        present[i] = false;
+    }
+    check(tree, present);
+    for (i = KEYS / 4; i < 3 * KEYS / 4; i += 3) {
+        make_key(key, sizeof(key), i);
+        assert(BTree_delete(tree, key));
+        assert(!BTree_delete(tree, key));
+        present[i] = false;
+    }
+    check(tree, present);
+    for (i = 0; i < KEYS; i++) {
+        if (present[i]) {
+            make_key(key, sizeof(key), i);
+            assert(BTree_delete(tree, key));
+            present[i] = false;
+        }
+    }
+    check(tree, present);
+    assert(tree->count == 0);
+
+    BTree_destroy(tree);
+    printf("btree_delete: ok\n");
+    return 0;
+}
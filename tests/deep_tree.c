@@ -0,0 +1,45 @@
+// A deserialized tree far deeper than the cached node heights can count:
+// heights saturate instead of wrapping, and saving it as a snapshot walks
+// it with a stack of the real depth
+#include "bitree.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#define KEYS 1000
+
+int main(void) {
+    // Every node only has a right child: a chain KEYS deep
+    FILE *fp = tmpfile();
+    assert(fp != NULL);
+    for (int i = 0; i < KEYS; i++) {
+        fprintf(fp, "%d 9 key-%05d\n#\n", i, i);
+    }
+    fprintf(fp, "#\n");
+    rewind(fp);
+    BiTreeNode *root = BiTree_deserialize(fp);
+    fclose(fp);
+    assert(root != NULL && root->size == KEYS);
+    assert(root->height == 255 && BiTree_depth(root) == KEYS);
+
+    char path[] = "/tmp/bitree_deep_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    BiTree chain = { .root = root, .node_count = KEYS };
+    assert(BiTree_saveSnapshot(&chain, path));
+    BiTree_free(root);
+
+    BiTree *loaded = BiTree_loadSnapshot(path);
+    assert(loaded != NULL && BiTree_size(loaded) == KEYS);
+    assert(BiTree_depth(loaded->root) == 10);
+    char key[16];
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "key-%05d", i);
+        assert(BiTree_lookup(loaded, key) != NULL);
+    }
+    BiTree_destroy(loaded);
+    unlink(path);
+    printf("deep_tree: ok\n");
+    return 0;
+}
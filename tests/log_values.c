@@ -0,0 +1,111 @@
+// Values written through a BiTreeLog survive a reopen whether they come
+// back from the log or from the snapshot a compaction folded them into,
+// and a segment written before value records existed is upgraded in place
+#include "bitree_log.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define COUNTERS 500
+#define ROUNDS 4
+
+static void counter_key(char *key, size_t size, int i) {
+    snprintf(key, size, "counter-%04d", i);
+}
+
+// Every counter holds ROUNDS * i except every fifth, which was deleted and
+// then counted down by i; "pinned" holds the last value put
+static void check_values(BiTreeLog *log) {
+    char key[32];
+    BiTreeValue value;
+    for (int i = 0; i < COUNTERS; i++) {
+        counter_key(key, sizeof(key), i);
+        assert(BiTreeLog_get(log, key, &value));
+        assert(value.i64 == (i % 5 == 0 ? -i : ROUNDS * i));
+    }
+    assert(BiTreeLog_get(log, "pinned", &value) && value.f64 == 0.5);
+    assert(BiTreeLog_contains(log, "old-key"));
+    assert(BiTreeLog_size(log) == COUNTERS + 2);
+}
+
+// Version field of the header of the segment at path
+static uint32_t segment_version(const char *path, uint32_t *set) {
+    FILE *fp = fopen(path, "r+b");
+    assert(fp != NULL);
+    uint32_t version;
+    assert(fseek(fp, 8, SEEK_SET) == 0 && fread(&version, sizeof(version), 1, fp) == 1);
+    if (set != NULL) {
+        assert(fseek(fp, 8, SEEK_SET) == 0 && fwrite(set, sizeof(*set), 1, fp) == 1);
+    }
+    fclose(fp);
+    return version;
+}
+
+int main(void) {
+    char dir[] = "/tmp/bitree_log_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64];
+    char segment[80];
+    snprintf(path, sizeof(path), "%s/tree", dir);
+    snprintf(segment, sizeof(segment), "%s.wal", path);
+
+    // Inserts and deletes are the same records in version 1, so a log of
+    // them relabelled as version 1 is what an older build left behind
+    BiTreeLog *log = BiTreeLog_open(path, true);
+    assert(log != NULL);
+    assert(BiTreeLog_insert(log, "old-key"));
+    assert(BiTreeLog_close(log));
+    uint32_t old_version = 1;
+    assert(segment_version(segment, &old_version) == BITREE_LOG_VERSION);
+
+    log = BiTreeLog_open(path, false);
+    assert(log != NULL && BiTreeLog_contains(log, "old-key"));
+    assert(segment_version(segment, NULL) == BITREE_LOG_VERSION);
+    char key[32];
+    int64_t result;
+    for (int round = 0; round < ROUNDS; round++) {
+        for (int i = 0; i < COUNTERS; i++) {
+            counter_key(key, sizeof(key), i);
+            assert(BiTreeLog_incr(log, key, i, &result) && result == (round + 1) * i);
+        }
+    }
+    for (int i = 0; i < COUNTERS; i += 5) {
+        counter_key(key, sizeof(key), i);
+        assert(BiTreeLog_delete(log, key));
+        assert(BiTreeLog_incr(log, key, -i, &result) && result == -i);
+    }
+    assert(BiTreeLog_put(log, "pinned", (BiTreeValue){ .f64 = 0.25 }));
+    assert(BiTreeLog_put(log, "pinned", (BiTreeValue){ .f64 = 0.5 }));
+    check_values(log);
+    assert(BiTreeLog_close(log));
+
+    // Back from the log alone
+    log = BiTreeLog_open(path, false);
+    assert(log != NULL);
+    check_values(log);
+
+    // Back from the snapshot, with the log emptied by a compaction
+    assert(BiTreeLog_compact(log));
+    BiTreeLog_waitCompaction(log);
+    assert(BiTreeLog_close(log));
+    BiTree *snapshot = BiTree_loadSnapshot(path);
+    BiTreeValue value;
+    assert(snapshot != NULL && BiTree_get(snapshot, "pinned", &value) && value.f64 == 0.5);
+    BiTree_destroy(snapshot);
+    log = BiTreeLog_open(path, false);
+    assert(log != NULL);
+    check_values(log);
+    assert(BiTreeLog_close(log));
+
+    char file[80];
+    const char *suffixes[] = { "", ".wal", ".wal.1" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+        unlink(file);
+    }
+    rmdir(dir);
+    printf("log_values: ok\n");
+    return 0;
+}
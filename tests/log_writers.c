@@ -0,0 +1,87 @@
+// Concurrent writers on a BiTreeLog with a compaction threshold small
+// enough that the active segment is rotated many times while they run.
+// Every acknowledged write must survive a reopen.
+#include "bitree_log.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#define WRITERS 8
+#define KEYS_PER_WRITER 4000
+
+static BiTreeLog *wal;
+
+static void writer_key(char *key, size_t size, int writer, int i) {
+    snprintf(key, size, "writer-%d-key-%06d", writer, i);
+}
+
+// Insert every key of the writer and delete every third one again
+static void* writer_main(void *arg) {
+    int writer = (int)(intptr_t)arg;
+    char key[64];
+    for (int i = 0; i < KEYS_PER_WRITER; i++) {
+        writer_key(key, sizeof(key), writer, i);
+        assert(BiTreeLog_insert(wal, key));
+        if (i % 3 == 0) {
+            assert(BiTreeLog_delete(wal, key));
+        }
+    }
+    return NULL;
+}
+
+static void check_keys(BiTreeLog *log) {
+    char key[64];
+    size_t expected = 0;
+    for (int writer = 0; writer < WRITERS; writer++) {
+        for (int i = 0; i < KEYS_PER_WRITER; i++) {
+            writer_key(key, sizeof(key), writer, i);
+            assert(BiTreeLog_contains(log, key) == (i % 3 != 0));
+            expected += i % 3 != 0;
+        }
+    }
+    assert(BiTreeLog_size(log) == expected);
+}
+
+int main(void) {
+    // A hang here is the failure mode this test is about
+    alarm(120);
+
+    char dir[] = "/tmp/bitree_log_XXXXXX";
+    assert(mkdtemp(dir) != NULL);
+    char path[64];
+    snprintf(path, sizeof(path), "%s/tree", dir);
+
+    wal = BiTreeLog_open(path, false);
+    assert(wal != NULL);
+    BiTreeLog_setCompactBytes(wal, 4096);
+
+    pthread_t threads[WRITERS];
+    for (int writer = 0; writer < WRITERS; writer++) {
+        assert(pthread_create(&threads[writer], NULL, writer_main, (void *)(intptr_t)writer) == 0);
+    }
+    for (int writer = 0; writer < WRITERS; writer++) {
+        pthread_join(threads[writer], NULL);
+    }
+    BiTreeLog_waitCompaction(wal);
+    check_keys(wal);
+    assert(BiTreeLog_close(wal));
+
+    // Replay the snapshot and whatever segments the last compaction left
+    wal = BiTreeLog_open(path, false);
+    assert(wal != NULL);
+    check_keys(wal);
+    assert(BiTreeLog_close(wal));
+
+    char file[80];
+    const char *suffixes[] = { "", ".wal", ".wal.1" };
+    for (size_t i = 0; i < sizeof(suffixes) / sizeof(suffixes[0]); i++) {
+        snprintf(file, sizeof(file), "%s%s", path, suffixes[i]);
+        unlink(file);
+    }
+    rmdir(dir);
+    printf("log_writers: %d writers, %d keys each: ok\n", WRITERS, KEYS_PER_WRITER);
+    return 0;
+}
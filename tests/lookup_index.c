@@ -0,0 +1,130 @@
+// The hash index behind BiTree_lookup must follow the tree through single
+// and batch writes, map calls, splay mode and snapshot loads: every lookup
+// through it returns the node a plain BiTree_find descent returns, never a
+// stale or freed one
+#include "bitree.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#define KEYS 4000
+#define ROUNDS 12
+#define BATCH 64
+
+static char keys[KEYS][32];
+
+static unsigned next_random(unsigned *state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+// Half the keys share their first 8 bytes, so they only differ past the
+// prefix the index hashes and compares first
+static void make_keys(void) {
+    for (int i = 0; i < KEYS; i++) {
+        if (i % 2 == 0) {
+            snprintf(keys[i], sizeof(keys[i]), "samepref-%05d", i);
+        } else {
+            snprintf(keys[i], sizeof(keys[i]), "%x", i * 2654435761u);
+        }
+    }
+}
+
+static void check(BiTree *tree) {
+    assert(tree->index != NULL);
+    size_t found = 0;
+    for (int i = 0; i < KEYS; i++) {
+        BiTreeNode *node = BiTree_find(tree->root, keys[i]);
+        assert(BiTree_lookup(tree, keys[i]) == node);
+        assert(node == NULL || strcmp(node->data, keys[i]) == 0);
+        found += node != NULL;
+    }
+    assert(found == BiTree_size(tree));
+    assert(BiTree_lookup(tree, "samepref-absent") == NULL);
+}
+
+// One round of mixed writes: single inserts and deletes, map calls, and a
+// sorted and an unsorted batch each way
+static void churn(BiTree *tree, unsigned *state) {
+    const char *batch[BATCH];
+    for (int n = 0; n < 400; n++) {
+        const char *key = keys[next_random(state) % KEYS];
+        BiTreeValue value;
+        switch (next_random(state) % 5) {
+        case 0:
+            BiTree_insert(tree, key);
+            break;
+        case 1:
+            BiTree_delete(tree, key);
+            break;
+        case 2:
+            assert(BiTree_put(tree, key, (BiTreeValue){ .i64 = n }));
+            break;
+        case 3:
+            BiTree_remove(tree, key, &value);
+            break;
+        default:
+            assert(BiTree_getOrInsert(tree, key, NULL) != NULL);
+            break;
+        }
+    }
+    for (int pass = 0; pass < 4; pass++) {
+        // Even passes take a run of the ascending samepref keys, odd ones
+        // random keys
+        int first = 2 * (next_random(state) % (KEYS / 2 - BATCH));
+        for (int i = 0; i < BATCH; i++) {
+            batch[i] = pass % 2 == 0 ? keys[first + 2 * i] : keys[next_random(state) % KEYS];
+        }
+        bool sorted = pass % 2 == 0;
+        if (pass < 2) {
+            BiTree_insertBatch(tree, batch, BATCH, sorted);
+        } else {
+            BiTree_deleteBatch(tree, batch, BATCH, sorted);
+        }
+    }
+}
+
+int main(void) {
+    make_keys();
+    unsigned state = 2024;
+
+    // Index on from the start
+    BiTree *tree = BiTree_new(NULL);
+    assert(tree != NULL && BiTree_enableIndex(tree));
+    for (int round = 0; round < ROUNDS; round++) {
+        // Splay mode for a few rounds, then back to AVL, which relinks
+        // every node
+        assert(BiTree_setSplay(tree, round % 4 == 1 || round % 4 == 2));
+        churn(tree, &state);
+        BiTree_reorder(tree->root, "inorder");
+        check(tree);
+    }
+
+    // Index turned on over an existing tree, then off and on again
+    BiTree_disableIndex(tree);
+    churn(tree, &state);
+    assert(BiTree_enableIndex(tree));
+    check(tree);
+    churn(tree, &state);
+    check(tree);
+
+    // A loaded snapshot, whose nodes and keys live in its arena and mapping
+    char path[] = "/tmp/bitree_index_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    assert(BiTree_saveSnapshot(tree, path));
+    BiTree_destroy(tree);
+    tree = BiTree_loadSnapshot(path);
+    assert(tree != NULL && BiTree_enableIndex(tree));
+    check(tree);
+    for (int round = 0; round < 3; round++) {
+        churn(tree, &state);
+        check(tree);
+    }
+    unlink(path);
+
+    BiTree_destroy(tree);
+    printf("lookup_index: ok\n");
+    return 0;
+}
@@ -0,0 +1,124 @@
+// A map generated by MAP_GENERATE: put overwrites without growing, remove
+// hands back the value and recycles the node, and foreach stays in key
+// order through mixed inserts and removes
+#include "map_gen.h"
+
+#include <assert.h>
+#include <stdint.h>
+
+MAP_GENERATE(IdMap, uint64_t, int64_t, MAP_CMP_NUMBER)
+
+#define KEYS 3000
+
+// Keys spread over the whole range, ends included, so the comparator
+// never gets away with a subtraction
+static uint64_t key_of(size_t i) {
+    return i == 0 ? 0 : i == KEYS - 1 ? UINT64_MAX : (uint64_t)i << 52 | i;
+}
+
+static bool present[KEYS];
+static int64_t values[KEYS];
+
+typedef struct {
+    size_t next;                // reference index to look from
+    size_t limit;
+    size_t seen;
+} Walk;
+
+// foreach visitor: entries come in the order of the reference, which
+// key_of keeps sorted
+static bool expect_next(const uint64_t *key, int64_t *value, void *ctx) {
+    Walk *walk = ctx;
+    while (walk->next < KEYS && !present[walk->next]) {
+        walk->next++;
+    }
+    assert(walk->next < KEYS && *key == key_of(walk->next) && *value == values[walk->next]);
+    walk->next++;
+    return ++walk->seen < walk->limit;
+}
+
+static void check(IdMap *map) {
+    size_t count = 0;
+    for (size_t i = 0; i < KEYS; i++) {
+        int64_t *value = IdMap_get(map, key_of(i));
+        assert(present[i] ? value != NULL && *value == values[i] : value == NULL);
+        count += present[i];
+    }
+    assert(IdMap_size(map) == count);
+    Walk walk = { 0, SIZE_MAX, 0 };
+    assert(IdMap_foreach(map, expect_next, &walk) == count && walk.seen == count);
+    Walk head = { 0, 10, 0 };
+    assert(IdMap_foreach(map, expect_next, &head) == (count < 10 ? count : 10));
+}
+
+int main(void) {
+    IdMap *map = IdMap_new();
+    assert(map != NULL);
+    unsigned state = 99;
+    for (size_t n = 0; n < KEYS; n++) {
+        state = state * 1103515245u + 12345u;
+        size_t i = (size_t)(state >> 8) % KEYS;
+        int64_t value = (int64_t)n - KEYS / 2;
+        assert(IdMap_put(map, key_of(i), value) == !present[i]);
+        present[i] = true;
+        values[i] = value;
+    }
+    check(map);
+
+    // Overwriting a key keeps its node and the count
+    size_t count = IdMap_size(map);
+    for (size_t i = 0; i < KEYS; i += 3) {
+        if (present[i]) {
+            int64_t *slot = IdMap_get(map, key_of(i));
+            assert(!IdMap_put(map, key_of(i), -values[i] - 1));
+            assert(IdMap_get(map, key_of(i)) == slot);
+            values[i] = -values[i] - 1;
+        }
+    }
+    assert(IdMap_size(map) == count);
+    check(map);
+
+    // Removed nodes go on the free list and are handed out again before
+    // any new block is carved
+    static bool removed[KEYS];
+    for (size_t i = 0; i < KEYS; i++) {
+        if (i % 4 == 1 || !present[i]) {
+            int64_t *slot = IdMap_get(map, key_of(i));
+            int64_t value = 12345;
+            assert(IdMap_remove(map, key_of(i), &value) == present[i]);
+            if (present[i]) {
+                assert(value == values[i] && &map->free_nodes->value == slot);
+                removed[i] = true;
+            } else {
+                assert(value == 12345);
+            }
+            present[i] = false;
+        }
+    }
+    check(map);
+    size_t used = map->block_used;
+    IdMapBlock *blocks = map->blocks;
+    for (size_t i = 0; i < KEYS; i++) {
+        if (!removed[i]) {
+            continue;
+        }
+        IdMapNode *recycled = map->free_nodes;
+        assert(recycled != NULL);
+        assert(IdMap_put(map, key_of(i), (int64_t)i));
+        assert(IdMap_get(map, key_of(i)) == &recycled->value);
+        present[i] = true;
+        values[i] = (int64_t)i;
+    }
+    assert(map->block_used == used && map->blocks == blocks && map->free_nodes == NULL);
+    check(map);
+
+    for (size_t i = 0; i < KEYS; i++) {
+        assert(IdMap_remove(map, key_of(i), NULL) == present[i]);
+        present[i] = false;
+    }
+    check(map);
+    assert(map->root == NULL);
+    IdMap_destroy(map);
+    printf("map_gen: ok\n");
+    return 0;
+}
@@ -0,0 +1,102 @@
+// The map calls keep a value per key, 16-character keys stay inside the
+// node, BiTree_serialize carries values and keys of any length through a
+// round trip, and snapshots keep values for every loader
+#include "bitree.h"
+#include "bitree_parallel.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#define KEYS 5000
+#define LONG_KEY 300
+
+int main(void) {
+    BiTree *tree = BiTree_new(NULL);
+    assert(tree != NULL);
+    char key[32];
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "%016x", i * 2654435761u);
+        assert(BiTree_put(tree, key, (BiTreeValue){ .i64 = -i }));
+        bool inserted;
+        BiTreeValue *slot = BiTree_getOrInsert(tree, key, &inserted);
+        assert(slot != NULL && !inserted && slot->i64 == -i);
+        slot->i64 += 2 * i;
+    }
+
+    BiTreeValue value;
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "%016x", i * 2654435761u);
+        BiTreeNode *node = BiTree_lookup(tree, key);
+        assert(node != NULL && node->data == node->inline_data);
+        assert(BiTree_get(tree, key, &value) && value.i64 == i);
+    }
+    assert(!BiTree_get(tree, "missing", &value));
+
+    FILE *fp = tmpfile();
+    assert(fp != NULL);
+    BiTree_serialize(fp, tree->root, "dfs");
+    rewind(fp);
+    BiTreeNode *copy = BiTree_deserialize(fp);
+    fclose(fp);
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "%016x", i * 2654435761u);
+        BiTreeNode *node = BiTree_find(copy, key);
+        assert(node != NULL && node->value.i64 == i);
+    }
+    BiTree_free(copy);
+
+    // Keys far longer than any fixed read buffer, one with spaces in it
+    BiTree *wide = BiTree_new(NULL);
+    assert(wide != NULL);
+    char long_key[LONG_KEY + 1];
+    for (int i = 0; i < 64; i++) {
+        memset(long_key, 'a' + i % 26, LONG_KEY);
+        snprintf(long_key + LONG_KEY - 16, 17, "%s%04d", i % 2 ? " spaced key " : "/path/to/id-", i);
+        assert(BiTree_put(wide, long_key, (BiTreeValue){ .i64 = i }));
+    }
+    fp = tmpfile();
+    assert(fp != NULL);
+    BiTree_serialize(fp, wide->root, "dfs");
+    rewind(fp);
+    copy = BiTree_deserialize(fp);
+    fclose(fp);
+    assert(copy != NULL && copy->size == 64);
+    for (int i = 0; i < 64; i++) {
+        memset(long_key, 'a' + i % 26, LONG_KEY);
+        snprintf(long_key + LONG_KEY - 16, 17, "%s%04d", i % 2 ? " spaced key " : "/path/to/id-", i);
+        BiTreeNode *node = BiTree_find(copy, long_key);
+        assert(node != NULL && strlen(node->data) == LONG_KEY && node->value.i64 == i);
+    }
+    BiTree_free(copy);
+    BiTree_destroy(wide);
+
+    char path[] = "/tmp/bitree_values_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    assert(BiTree_saveSnapshot(tree, path));
+    assert(BiTree_verifySnapshot(path));
+    TaskPool *pool = TaskPool_new(4);
+    assert(pool != NULL);
+    BiTree *loaded[2] = { BiTree_loadSnapshot(path), BiTree_loadSnapshotParallel(pool, path) };
+    for (int l = 0; l < 2; l++) {
+        assert(loaded[l] != NULL && BiTree_size(loaded[l]) == KEYS);
+        for (int i = 0; i < KEYS; i++) {
+            snprintf(key, sizeof(key), "%016x", i * 2654435761u);
+            assert(BiTree_get(loaded[l], key, &value) && value.i64 == i);
+        }
+        BiTree_destroy(loaded[l]);
+    }
+    TaskPool_destroy(pool);
+    unlink(path);
+
+    for (int i = 0; i < KEYS; i += 2) {
+        snprintf(key, sizeof(key), "%016x", i * 2654435761u);
+        assert(BiTree_remove(tree, key, &value) && value.i64 == i);
+        assert(!BiTree_remove(tree, key, &value));
+    }
+    assert(BiTree_size(tree) == KEYS / 2);
+    BiTree_destroy(tree);
+    printf("map_values: ok\n");
+    return 0;
+}
@@ -0,0 +1,209 @@
+// Radix inserts and deletes over keys that share prefixes at every length,
+// so labels are split on insert and merged back on delete. After each step
+// search, full, range and prefix scans must agree with a sorted reference.
+#include "radix.h"
+
+#include <assert.h>
+
+#define MAX_KEYS 2048
+#define CHECK_EVERY 29
+
+static char *keys[MAX_KEYS];   // sorted by strcmp
+static bool present[MAX_KEYS];
+static size_t nkeys;
+
+static unsigned next_random(unsigned *state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+static int compare_keys(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+// Keys joined from short pieces, which overlap in many ways, plus URL-like
+// keys whose shared prefixes are longer than a word
+static void make_keys(void) {
+    const char *pieces[] = { "a", "ab", "abc", "b", "ba", "/x/", "/x/y", "q" };
+    const size_t npieces = sizeof(pieces) / sizeof(pieces[0]);
+    char key[128];
+    for (size_t i = 0; i < npieces * npieces * npieces; i++) {
+        snprintf(key, sizeof(key), "%s%s%s", pieces[i % npieces],
+                 i >= npieces ? pieces[i / npieces % npieces] : "",
+                 i >= npieces * npieces ? pieces[i / npieces / npieces] : "");
+        keys[nkeys++] = strdup(key);
+    }
+    for (int i = 0; i < 300; i++) {
+        snprintf(key, sizeof(key), "https://example.com/users/%d%s", i * 7 % 100,
+                 i < 100 ? "" : i < 200 ? "/profile" : "/profile/settings");
+        keys[nkeys++] = strdup(key);
+    }
+    qsort(keys, nkeys, sizeof(char *), compare_keys);
+    size_t unique = 0;
+    for (size_t i = 0; i < nkeys; i++) {
+        if (unique > 0 && strcmp(keys[unique - 1], keys[i]) == 0) {
+            free(keys[i]);
+        } else {
+            keys[unique++] = keys[i];
+        }
+    }
+    nkeys = unique;
+    assert(nkeys < MAX_KEYS);
+}
+
+typedef struct {
+    const char *lo;
+    const char *hi;
+    const char *prefix;
+    size_t next;                // index of the next expected key
+    size_t limit;               // stop after this many keys
+    size_t seen;
+} Expect;
+
+static bool wanted(const Expect *expect, size_t i) {
+    return present[i]
+        && (expect->lo == NULL || strcmp(keys[i], expect->lo) >= 0)
+        && (expect->hi == NULL || strcmp(keys[i], expect->hi) <= 0)
+        && (expect->prefix == NULL || strncmp(keys[i], expect->prefix, strlen(expect->prefix)) == 0);
+}
+
+// Scan visitor: each key must be the next wanted one of the reference
+static bool expect_next(const char *key, void *ctx) {
+    Expect *expect = ctx;
+    while (expect->next < nkeys && !wanted(expect, expect->next)) {
+        expect->next++;
+    }
+    assert(expect->next < nkeys && strcmp(key, keys[expect->next]) == 0);
+    expect->next++;
+    return ++expect->seen < expect->limit;
+}
+
+// The scan visited every wanted key and nothing else
+static void expect_done(Expect *expect, size_t visited) {
+    assert(visited == expect->seen);
+    if (expect->seen < expect->limit) {
+        while (expect->next < nkeys) {
+            assert(!wanted(expect, expect->next++));
+        }
+    }
+}
+
+// A bound near a random key: the key, a cut of it that may end mid-label,
+// or the key with a byte added
+static const char* bound_near(unsigned *state, char *buffer, size_t size) {
+    const char *key = keys[next_random(state) % nkeys];
+    switch (next_random(state) % 4) {
+    case 0:
+        return NULL;
+    case 1:
+        return key;
+    case 2:
+        snprintf(buffer, size, "%.*s", (int)(next_random(state) % (strlen(key) + 1)), key);
+        return buffer;
+    default:
+        snprintf(buffer, size, "%s%c", key, "a/~"[next_random(state) % 3]);
+        return buffer;
+    }
+}
+
+// Every node below the root ends a key or branches, children are sorted
+// by their first label byte, and the terminals add up to count
+static void check_shape(const Radix *tree) {
+    const RadixNode *stack[4096];
+    size_t top = 0;
+    size_t terminals = 0;
+    stack[top++] = tree->root;
+    while (top > 0) {
+        const RadixNode *node = stack[--top];
+        terminals += node->terminal;
+        if (node != tree->root) {
+            assert(node->length > 0 && (node->terminal || node->nchildren >= 2));
+        }
+        for (int i = 0; i < node->nchildren; i++) {
+            assert(i == 0 || node->children[i - 1]->label[0] < node->children[i]->label[0]);
+            assert(top < sizeof(stack) / sizeof(stack[0]));
+            stack[top++] = node->children[i];
+        }
+    }
+    assert(terminals == tree->count);
+}
+
+static void check(const Radix *tree, unsigned *state) {
+    size_t count = 0;
+    for (size_t i = 0; i < nkeys; i++) {
+        assert(Radix_search(tree, keys[i]) == present[i]);
+        count += present[i];
+    }
+    assert(tree->count == count);
+    check_shape(tree);
+
+    Expect full = { .limit = SIZE_MAX };
+    expect_done(&full, Radix_scan(tree, NULL, NULL, expect_next, &full));
+    assert(full.seen == count);
+
+    char lo[160];
+    char hi[160];
+    for (int r = 0; r < 8; r++) {
+        Expect range = { .lo = bound_near(state, lo, sizeof(lo)), .hi = bound_near(state, hi, sizeof(hi)) };
+        range.limit = r % 4 == 3 ? 1 + next_random(state) % 8 : SIZE_MAX;
+        expect_done(&range, Radix_scan(tree, range.lo, range.hi, expect_next, &range));
+
+        // Cuts of keys end mid-label as often as on a node boundary
+        const char *key = keys[next_random(state) % nkeys];
+        snprintf(lo, sizeof(lo), "%.*s", (int)(next_random(state) % (strlen(key) + 1)), key);
+        Expect prefix = { .prefix = lo, .limit = SIZE_MAX };
+        expect_done(&prefix, Radix_prefixScan(tree, lo, expect_next, &prefix));
+    }
+}
+
+int main(void) {
+    make_keys();
+    Radix *tree = Radix_new();
+    assert(tree != NULL);
+    size_t *order = malloc(nkeys * sizeof(size_t));
+    assert(order != NULL);
+    unsigned state = 12345;
+
+    // Each round inserts every key in shuffled order, then deletes them
+    // ascending, descending or shuffled
+    for (int round = 0; round < 3; round++) {
+        for (size_t i = 0; i < nkeys; i++) {
+            order[i] = i;
+        }
+        for (size_t i = nkeys - 1; i > 0; i--) {
+            size_t j = next_random(&state) % (i + 1);
+            size_t swap = order[i];
+            order[i] = order[j];
+            order[j] = swap;
+        }
+        for (size_t i = 0; i < nkeys; i++) {
+            assert(Radix_insert(tree, keys[order[i]]));
+            assert(!Radix_insert(tree, keys[order[i]]));
+            present[order[i]] = true;
+            if (i % CHECK_EVERY == 0) {
+                check(tree, &state);
+            }
+        }
+        check(tree, &state);
+
+        for (size_t i = 0; i < nkeys; i++) {
+            size_t k = round == 0 ? i : round == 1 ? nkeys - 1 - i : order[i];
+            assert(Radix_delete(tree, keys[k]));
+            assert(!Radix_delete(tree, keys[k]));
+            present[k] = false;
+            if (i % CHECK_EVERY == 0) {
+                check(tree, &state);
+            }
+        }
+        check(tree, &state);
+        assert(tree->count == 0 && tree->root->nchildren == 0);
+    }
+
+    Radix_destroy(tree);
+    free(order);
+    for (size_t i = 0; i < nkeys; i++) {
+        free(keys[i]);
+    }
+    printf("radix_ops: %zu keys: ok\n", nkeys);
+    return 0;
+}
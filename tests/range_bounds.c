@@ -0,0 +1,83 @@
+// Every engine's range scan follows the same contract: [lo, hi] inclusive,
+// keys in order, a NULL bound open
+#include "bitree.h"
+#include "btree.h"
+#include "radix.h"
+
+#include <assert.h>
+
+#define KEYS 3000
+
+typedef struct {
+    char keys[KEYS][16];
+    size_t count;
+} Seen;
+
+static bool collect(const char *key, void *ctx) {
+    Seen *seen = ctx;
+    assert(seen->count < KEYS);
+    snprintf(seen->keys[seen->count++], sizeof(seen->keys[0]), "%s", key);
+    return true;
+}
+
+static bool collect_node(BiTreeNode *node, void *ctx) {
+    return collect(node->data, ctx);
+}
+
+static bool same(const Seen *a, const Seen *b) {
+    return a->count == b->count && memcmp(a->keys, b->keys, a->count * sizeof(a->keys[0])) == 0;
+}
+
+static Seen expected, got;
+
+int main(void) {
+    BiTree *tree = BiTree_new(NULL);
+    BTree *btree = BTree_new();
+    Radix *radix = Radix_new();
+    assert(tree != NULL && btree != NULL && radix != NULL);
+    char key[16];
+    for (int i = 0; i < KEYS; i++) {
+        // Every other number, so bounds fall both on and between keys
+        snprintf(key, sizeof(key), "k%05d", 2 * i);
+        assert(BiTree_insert(tree, key) && BTree_insert(btree, key) && Radix_insert(radix, key));
+    }
+    BiTreeFrozen *frozen = BiTree_freeze(tree);
+    assert(frozen != NULL);
+
+    const char *bounds[][2] = {
+        { NULL, NULL }, { NULL, "k00100" }, { NULL, "k00101" }, { "k05000", NULL },
+        { "k05001", NULL }, { "k00010", "k00020" }, { "k00011", "k00019" },
+        { NULL, "a" }, { "z", NULL }, { "k00020", "k00010" },
+    };
+    for (size_t b = 0; b < sizeof(bounds) / sizeof(bounds[0]); b++) {
+        const char *lo = bounds[b][0];
+        const char *hi = bounds[b][1];
+        expected.count = 0;
+        for (int i = 0; i < KEYS; i++) {
+            snprintf(key, sizeof(key), "k%05d", 2 * i);
+            if ((lo == NULL || strcmp(lo, key) <= 0) && (hi == NULL || strcmp(key, hi) <= 0)) {
+                collect(key, &expected);
+            }
+        }
+
+        got.count = 0;
+        assert(BiTree_range(tree->root, lo, hi, collect_node, &got) == expected.count);
+        assert(same(&got, &expected));
+        got.count = 0;
+        assert(BiTreeFrozen_range(frozen, lo, hi, collect, &got) == expected.count);
+        assert(same(&got, &expected));
+        got.count = 0;
+        assert(BTree_scan(btree, lo, hi, collect, &got) == expected.count);
+        assert(same(&got, &expected));
+        got.count = 0;
+        assert(Radix_scan(radix, lo, hi, collect, &got) == expected.count);
+        assert(same(&got, &expected));
+    }
+
+    BiTreeFrozen_destroy(frozen);
+    Radix_destroy(radix);
+    BTree_destroy(btree);
+    BiTree_destroy(tree);
+    printf("range_bounds: ok\n");
+    return 0;
+}
@@ -0,0 +1,29 @@
+// BiTree_reorder returns the node each traversal starts at, and the
+// searches it used to go through reject a NULL key instead of crashing
+#include "bitree.h"
+
+#include <assert.h>
+
+int main(void) {
+    BiTree *tree = BiTree_new(NULL);
+    assert(tree != NULL);
+    assert(BiTree_reorder(tree->root, "inorder") == NULL);
+
+    const char *keys[] = { "m", "f", "t", "c", "h", "x" };
+    for (size_t i = 0; i < sizeof(keys) / sizeof(keys[0]); i++) {
+        assert(BiTree_insert(tree, keys[i]));
+    }
+    assert(BiTree_reorder(tree->root, "preorder") == tree->root);
+    assert(strcmp(BiTree_reorder(tree->root, "inorder")->data, "c") == 0);
+    assert(strcmp(BiTree_reorder(tree->root, "postorder")->data, "c") == 0);
+    assert(BiTree_delete(tree, "c"));
+    assert(strcmp(BiTree_reorder(tree->root, "inorder")->data, "f") == 0);
+    assert(strcmp(BiTree_reorder(tree->root, "postorder")->data, "h") == 0);
+    assert(BiTree_reorder(tree->root, "levelorder") == NULL);
+
+    assert(BiTree_dfs(tree->root, NULL, "inorder") == NULL);
+    assert(BiTree_bfs(tree->root, NULL) == NULL);
+    BiTree_destroy(tree);
+    printf("reorder: ok\n");
+    return 0;
+}
@@ -0,0 +1,69 @@
+// Snapshots whose checksums are valid but whose keys are out of order,
+// inside a chunk or across a chunk boundary, must be refused by every
+// loader instead of being linked into a broken search tree
+#include "bitree.h"
+#include "bitree_parallel.h"
+
+#include <assert.h>
+#include <unistd.h>
+
+#define KEYS (2 * BITREE_SNAPSHOT_CHUNK)
+
+// Exchange the keys of two nodes, so an inorder walk writes them swapped
+static void swap_keys(BiTreeNode *a, BiTreeNode *b) {
+    char *data = a->data;
+    uint64_t prefix = a->prefix;
+    a->data = b->data;
+    a->prefix = b->prefix;
+    b->data = data;
+    b->prefix = prefix;
+}
+
+// Save tree with the keys of ranks i and j swapped, then check that no
+// loader accepts the file
+static void check_refused(BiTree *tree, const char *path, size_t i, size_t j) {
+    BiTreeNode *a = BiTree_select(tree->root, i);
+    BiTreeNode *b = BiTree_select(tree->root, j);
+    swap_keys(a, b);
+    assert(BiTree_saveSnapshot(tree, path));
+    swap_keys(a, b);
+
+    TaskPool *pool = TaskPool_new(4);
+    assert(pool != NULL);
+    assert(BiTree_loadSnapshot(path) == NULL);
+    assert(BiTree_loadSnapshotParallel(pool, path) == NULL);
+    assert(!BiTree_verifySnapshot(path));
+    TaskPool_destroy(pool);
+}
+
+int main(void) {
+    char path[] = "/tmp/bitree_snapshot_XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+
+    BiTree *tree = BiTree_new(NULL);
+    assert(tree != NULL);
+    char key[32];
+    for (int i = 0; i < KEYS; i++) {
+        snprintf(key, sizeof(key), "key-%08d", i);
+        assert(BiTree_insert(tree, key));
+    }
+
+    // The intact file loads
+    assert(BiTree_saveSnapshot(tree, path));
+    BiTree *loaded = BiTree_loadSnapshot(path);
+    assert(loaded != NULL && BiTree_size(loaded) == KEYS);
+    BiTree_destroy(loaded);
+
+    // First and last key of a chunk: out of order inside it
+    check_refused(tree, path, 0, BITREE_SNAPSHOT_CHUNK - 1);
+    // Last key of a chunk and first of the next: each chunk is still in
+    // order, only the boundary is not
+    check_refused(tree, path, BITREE_SNAPSHOT_CHUNK - 1, BITREE_SNAPSHOT_CHUNK);
+
+    BiTree_destroy(tree);
+    unlink(path);
+    printf("snapshot_order: ok\n");
+    return 0;
+}
@@ -0,0 +1,198 @@
+// Readers of a BiTreeSync against a stable key set while writers insert,
+// delete and take snapshots around it. Readers must never miss a stable
+// key or see one out of order, whatever the writers are doing, and read
+// throughput is reported as the number of readers grows.
+//
+// Usage: test_sync_stress [max-readers] [seconds-per-round]
+#include "bitree_sync.h"
+
+#include <assert.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <unistd.h>
+
+#define STABLE_KEYS 20000
+#define RANGE_KEYS 100
+#define WRITERS 2
+#define CHURN_KEYS 5000
+
+static BiTreeSync *map;
+static atomic_bool stop;
+
+static double now_seconds(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void stable_key(char *key, size_t size, unsigned i) {
+    snprintf(key, size, "stable-%06u", i);
+}
+
+static unsigned next_random(unsigned *state) {
+    *state = *state * 1103515245u + 12345u;
+    return *state >> 8;
+}
+
+typedef struct {
+    char last[32];
+    size_t count;
+} RangeCheck;
+
+// Range visitor: keys arrive strictly increasing
+static bool check_order(BiTreeNode *node, void *ctx) {
+    RangeCheck *check = ctx;
+    assert(check->count == 0 || strcmp(check->last, node->data) < 0);
+    snprintf(check->last, sizeof(check->last), "%s", node->data);
+    check->count++;
+    return true;
+}
+
+typedef struct {
+    unsigned seed;
+    uint64_t ops;
+} ReaderRun;
+
+// Contains on stable and never-inserted keys, with a range over a window
+// of stable keys every 64 operations
+static void* reader_main(void *arg) {
+    ReaderRun *run = arg;
+    BiTreeSyncReader *reader = BiTreeSync_reader(map);
+    assert(reader != NULL);
+    unsigned state = run->seed;
+    char key[32];
+    char hi[32];
+    uint64_t ops = 0;
+    while (!atomic_load_explicit(&stop, memory_order_relaxed)) {
+        unsigned i = next_random(&state) % STABLE_KEYS;
+        if (ops % 64 == 63) {
+            unsigned first = i < STABLE_KEYS - RANGE_KEYS ? i : STABLE_KEYS - RANGE_KEYS;
+            stable_key(key, sizeof(key), first);
+            stable_key(hi, sizeof(hi), first + RANGE_KEYS - 1);
+            RangeCheck check = { "", 0 };
+            assert(BiTreeSync_range(reader, key, hi, check_order, &check) == RANGE_KEYS);
+            assert(check.count == RANGE_KEYS);
+        } else if (ops % 8 == 7) {
+            snprintf(key, sizeof(key), "absent-%06u", i);
+            assert(!BiTreeSync_contains(reader, key));
+        } else {
+            stable_key(key, sizeof(key), i);
+            assert(BiTreeSync_contains(reader, key));
+        }
+        ops++;
+    }
+    BiTreeSync_readerRelease(reader);
+    run->ops = ops;
+    return NULL;
+}
+
+static bool count_node(BiTreeNode *node, void *ctx) {
+    (void)node;
+    (*(size_t *)ctx)++;
+    return true;
+}
+
+// Insert and delete churn keys, which sort before the stable ones, and
+// check a snapshot every 256 writes
+static void* writer_main(void *arg) {
+    int writer = (int)(intptr_t)arg;
+    unsigned state = 7 + writer;
+    char key[32];
+    for (uint64_t ops = 0; !atomic_load_explicit(&stop, memory_order_relaxed); ops++) {
+        snprintf(key, sizeof(key), "churn-%d-%05u", writer, next_random(&state) % CHURN_KEYS);
+        if (ops % 2 == 0) {
+            BiTreeSync_insert(map, key);
+        } else {
+            BiTreeSync_delete(map, key);
+        }
+        if (ops % 256 == 255) {
+            BiTreeSyncVersion *version = BiTreeSync_snapshot(map);
+            assert(version != NULL);
+            BiTreeNode *root = BiTreeSync_versionRoot(version);
+            size_t count = 0;
+            BiTree_range(root, NULL, NULL, count_node, &count);
+            assert(count == BiTreeSync_versionSize(version));
+            assert(BiTree_countRange(root, "stable-", "stable-~") == STABLE_KEYS);
+            BiTreeSync_versionRelease(version);
+        }
+    }
+    return NULL;
+}
+
+// Run readers against the writers for the given time; returns reads/s
+static double run_round(int readers, double seconds) {
+    atomic_store(&stop, false);
+    pthread_t writer_ids[WRITERS];
+    for (int w = 0; w < WRITERS; w++) {
+        assert(pthread_create(&writer_ids[w], NULL, writer_main, (void *)(intptr_t)w) == 0);
+    }
+    pthread_t *reader_ids = malloc(readers * sizeof(pthread_t));
+    ReaderRun *runs = calloc(readers, sizeof(ReaderRun));
+    assert(reader_ids != NULL && runs != NULL);
+    double start = now_seconds();
+    for (int r = 0; r < readers; r++) {
+        runs[r].seed = 1 + r;
+        assert(pthread_create(&reader_ids[r], NULL, reader_main, &runs[r]) == 0);
+    }
+    usleep((useconds_t)(seconds * 1e6));
+    atomic_store(&stop, true);
+
+    uint64_t total = 0;
+    for (int r = 0; r < readers; r++) {
+        pthread_join(reader_ids[r], NULL);
+        total += runs[r].ops;
+    }
+    double elapsed = now_seconds() - start;
+    for (int w = 0; w < WRITERS; w++) {
+        pthread_join(writer_ids[w], NULL);
+    }
+    free(reader_ids);
+    free(runs);
+    return total / elapsed;
+}
+
+int main(int argc, char *argv[]) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    int max_readers = argc > 1 ? atoi(argv[1]) : (int)(cores > 1 ? cores : 2);
+    double seconds = argc > 2 ? strtod(argv[2], NULL) : 0.25;
+    if (max_readers < 1 || max_readers > BITREE_SYNC_MAX_READERS - 1 || seconds <= 0) {
+        fprintf(stderr, "Usage: %s [max-readers] [seconds-per-round]\n", argv[0]);
+        return 1;
+    }
+
+    map = BiTreeSync_new();
+    assert(map != NULL);
+    char key[32];
+    for (unsigned i = 0; i < STABLE_KEYS; i++) {
+        stable_key(key, sizeof(key), i);
+        assert(BiTreeSync_insert(map, key));
+    }
+
+    printf("sync_stress: %d stable keys, %d writers, %ld cores\n", STABLE_KEYS, WRITERS, cores);
+    // Reader counts double up to max_readers, which is always run
+    double single = 0;
+    for (int readers = 1; ; readers *= 2) {
+        if (readers > max_readers) {
+            readers = max_readers;
+        }
+        double rate = run_round(readers, seconds);
+        if (readers == 1) {
+            single = rate;
+        }
+        printf("  %3d readers: %12.0f reads/s  %5.2fx\n", readers, rate, rate / single);
+        if (readers == max_readers) {
+            break;
+        }
+    }
+
+    BiTreeSyncReader *reader = BiTreeSync_reader(map);
+    assert(BiTree_countRange(BiTreeSync_pin(reader), "stable-", "stable-~") == STABLE_KEYS);
+    BiTreeSync_unpin(reader);
+    BiTreeSync_readerRelease(reader);
+    BiTreeSync_destroy(map);
+    printf("sync_stress: ok\n");
+    return 0;
+}